@@ -0,0 +1,104 @@
+#ifndef CHAINALLOCATOR_HPP
+#define CHAINALLOCATOR_HPP
+
+#include <cstddef>
+
+
+
+using namespace std;
+
+
+
+//
+// source of the memory of the segments of the chain stores (see chainStore.hpp)
+// a store reserves its address space and asks its allocator for the memory of each segment it grows into,
+// the memory is released with the reservation of the store, disk-backed stores map their file instead
+// an allocator can be shared by stores and has to outlive them
+//
+class chainAllocator {
+
+  public:
+
+    virtual ~chainAllocator() {}
+
+    // provide the memory of the abytes of reserved address space at aaddress, returns false when there is none
+    virtual bool commit( char *aaddress, const size_t abytes ) = 0;
+
+    // the allocator of the stores that are not given one, an mmapAllocator
+    static chainAllocator &standard( void );
+};
+
+
+
+//
+// memory on demand, a page is provided by the kernel when it is first used
+//
+class mmapAllocator: public chainAllocator {
+
+  public:
+
+    bool commit( char *aaddress, const size_t abytes );
+};
+
+
+
+//
+// memory on demand in transparent huge pages of 2 MB, such that long sweeps over the chain miss the TLB less
+// the kernel uses regular pages when it has no huge pages available
+//
+class hugepageAllocator: public chainAllocator {
+
+  public:
+
+    bool commit( char *aaddress, const size_t abytes );
+};
+
+
+
+//
+// a fixed amount of memory that is mapped, and optionally locked, up front and handed to the stores a segment
+// at a time, such that a store that grows within the arena neither page faults nor waits for the kernel to find
+// memory, the segments beyond the arena are provided on demand
+//
+class arenaAllocator: public chainAllocator {
+
+  public:
+
+    arenaAllocator( const size_t abytes, const bool alock = false ); // constructor, maps abytes rounded up to segments
+    ~arenaAllocator();                                               // destructor, unmaps the part not handed out
+
+    bool   commit(    char *aaddress, const size_t abytes );
+    bool   good(      void ) const; // could the arena be mapped, and locked when requested
+    size_t available( void ) const; // the number of bytes not handed out yet
+
+  private:
+
+    // no copies of the arena
+    arenaAllocator( const arenaAllocator & );
+    arenaAllocator &operator=( const arenaAllocator & );
+
+    char   *arena;  // the part not handed out yet
+    size_t  length; // its number of bytes
+    bool    mapped; // could the arena be mapped, and locked when requested
+};
+
+
+
+//
+// debug check on heap allocations in the steady state of a chain, i.e. once it is warm
+// when built with ALLOCATION_CHECK (cmake -DALLOCATION_CHECK=ON) every heap allocation, by new or by the malloc
+// family, while a check is active aborts the program with a message, without it a check does nothing
+//
+class allocationCheck {
+
+  public:
+
+    allocationCheck( const bool aactive ); // start a check when aactive is true
+    ~allocationCheck();                    // end it
+
+  private:
+
+    bool active; // is a check started
+};
+
+#endif
@@ -0,0 +1,288 @@
+#ifndef CHAINSTORE_HPP
+#define CHAINSTORE_HPP
+
+#include <string>
+#include <vector>
+#include <new>
+#include <cstring>
+#include <cstdlib>
+#include <cstddef>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "chainAllocator.hpp"
+
+
+
+using namespace std;
+
+
+
+// number of bytes of a segment, the unit in which a store grows and in which a disk-backed store is paged in and evicted
+#define CHAIN_SEGMENT (1 << 24)
+
+// number of bytes of address space that a store reserves, only the segments in use take memory
+#define CHAIN_RESERVE ((size_t)1 << 40)
+
+// default number of bytes of a disk-backed store that are kept in memory
+#define CHAIN_RESIDENT ((size_t)1 << 30)
+
+
+
+//
+// vector of poses with 64-bit indices in a single mapping
+// the address space of the mapping is reserved up front and the store grows a segment at a time in place, such
+// that an append never copies the elements (it costs O(1) in the worst case) and their addresses never change
+// by default the memory of the segments is provided by an allocator (see chainAllocator.hpp), a disk-backed store
+// maps a file instead, such that chains larger than memory can be processed (out-of-core)
+// a disk-backed store keeps the segments that were touched last in memory, the least recently touched
+// segments are evicted when more than the resident number of bytes are touched, their poses stay in the file
+// and are paged in again with read-ahead when a range that includes them is touched
+// the elements are never destroyed, T must be trivially destructible, like the poses
+//
+template<typename T>
+class chainStore {
+
+  public:
+
+    chainStore( void ) : elements(NULL), count(0), capacity(0), bytes(0), reserved(0), allocator(&chainAllocator::standard()), file(-1), resident(CHAIN_RESIDENT), nresident(0), clock(0) {}
+
+    ~chainStore()
+    {
+      if( elements != NULL )
+	munmap( elements, reserved );
+      if( 0 <= file )
+	close( file );
+    }
+
+    // the number of elements
+    size_t size( void ) const
+    {
+      return count;
+    }
+
+    bool empty( void ) const
+    {
+      return 0 == count;
+    }
+
+    // element an, touch its range first when the store is disk-backed, the reference stays valid while the store exists
+    T &operator[]( const size_t an )
+    {
+      return elements[an];
+    }
+
+    const T &operator[]( const size_t an ) const
+    {
+      return elements[an];
+    }
+
+    // remove all elements, the mapping is kept
+    void clear( void )
+    {
+      count = 0;
+    }
+
+    // replace the elements by an copies of av
+    void assign( const size_t an, const T &av )
+    {
+      clear();
+      resize( an, av );
+    }
+
+    // append av, a segment is added when the store grows
+    void push_back( const T &av )
+    {
+      if( count == capacity )
+	reserve( count+1 );
+      count++;
+      touch( count-1, count-1 );
+      new (elements+count-1) T( av );
+    }
+
+    // change the number of elements, new elements are copies of av
+    // the new elements are touched a segment at a time, such that a disk-backed store stays within its resident bytes
+    void resize( const size_t an, const T &av )
+    {
+      reserve( an );
+      size_t block = max( (size_t)1, CHAIN_SEGMENT/sizeof(T) );
+      for( size_t first = count; first < an; first += block )
+      {
+	size_t last = min( an, first+block );
+	count = last;
+	touch( first, last-1 );
+	for( size_t i = first; i < last; i++ )
+	  new (elements+i) T( av );
+      }
+      count = an;
+    }
+
+    // make sure an elements can be stored, the segments that are added are mapped at the end of the store
+    // the address space is reserved by the first call, less than CHAIN_RESERVE bytes when that much is not available,
+    // it is aligned to the segments, such that they can be backed by huge pages
+    void reserve( const size_t an )
+    {
+      if( an <= capacity )
+	return;
+      if( elements == NULL )
+      {
+	reserved = CHAIN_RESERVE;
+	char *mapping = (char*)mmap( NULL, reserved+CHAIN_SEGMENT, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+	while( (mapping == (char*)MAP_FAILED) && (CHAIN_SEGMENT < reserved) )
+	{
+	  reserved /= 2;
+	  mapping   = (char*)mmap( NULL, reserved+CHAIN_SEGMENT, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+	}
+	if( mapping == (char*)MAP_FAILED )
+	{
+	  reserved = 0;
+	  throw bad_alloc();
+	}
+	size_t head = (CHAIN_SEGMENT - (uintptr_t)mapping % CHAIN_SEGMENT) % CHAIN_SEGMENT;
+	if( 0 < head )
+	  munmap( mapping, head );
+	munmap( mapping+head+reserved, CHAIN_SEGMENT-head );
+	elements = (T*)(mapping+head);
+      }
+      size_t newBytes = ((an*sizeof(T)+CHAIN_SEGMENT-1)/CHAIN_SEGMENT)*CHAIN_SEGMENT;
+      if( (reserved < newBytes) || !map( bytes, newBytes ) )
+	throw bad_alloc();
+      bytes    = newBytes;
+      capacity = newBytes/sizeof(T);
+      if( 0 <= file )
+	stamps.resize( bytes/CHAIN_SEGMENT, 0 );
+    }
+
+    // the allocator of the segments that are added from now on, it has to outlive the store
+    void setAllocator( chainAllocator &aallocator )
+    {
+      allocator = &aallocator;
+    }
+
+    // keep the elements in a new unlinked file in adirectory, of which at most aresident bytes stay in memory
+    // the elements so far are written to the file, which is mapped in place of them
+    // returns false when the file cannot be created, an anonymous store is kept then
+    bool backing( const string &adirectory, const size_t aresident )
+    {
+      string name = adirectory + "/copslam-poses-XXXXXX";
+      vector<char> path( name.begin(), name.end() );
+      path.push_back( '\0' );
+      int backingFile = mkstemp( &path[0] );
+      if( backingFile < 0 )
+	return false;
+      unlink( &path[0] );
+      bool written = true;
+      for( size_t done = 0; written && (done < count*sizeof(T)); )
+      {
+	ssize_t n = pwrite( backingFile, (char*)elements+done, count*sizeof(T)-done, done );
+	written   = (0 < n);
+	done     += written ? n : 0;
+      }
+      int previous = file;
+      file = backingFile;
+      if( !written || !map( 0, bytes ) )
+      {
+	file = previous;
+	close( backingFile );
+	return false;
+      }
+      if( 0 <= previous )
+	close( previous );
+      resident  = max( aresident, (size_t)CHAIN_SEGMENT );
+      nresident = 0;
+      stamps.assign( bytes/CHAIN_SEGMENT, 0 );
+      touch( 0, count-1 );
+      return true;
+    }
+
+    // is the store backed by a file
+    bool backed( void ) const
+    {
+      return 0 <= file;
+    }
+
+    // the elements afirst upto alast are about to be used, nothing happens unless the store is disk-backed
+    // the segments of the range that are not in memory are paged in with read-ahead, upto the resident bytes,
+    // and the least recently touched segments outside the range are evicted, the store exceeds its
+    // resident bytes only when the range itself is larger
+    void touch( const size_t afirst, const size_t alast )
+    {
+      if( (file < 0) || (count <= afirst) || (alast < afirst) )
+	return;
+      size_t first = (afirst*sizeof(T))/CHAIN_SEGMENT;
+      size_t last  = (min( alast, count-1 )*sizeof(T)+sizeof(T)-1)/CHAIN_SEGMENT;
+      if( (first == last) && (0 < clock) && (stamps[first] == clock) )
+	return;
+
+      // page in the segments of the range
+      clock++;
+      size_t advised = 0;
+      for( size_t s = first; s <= last; s++ )
+      {
+	if( (0 == stamps[s]) && (advised < resident) )
+	{
+	  madvise( segment( s ), segmentBytes( s ), MADV_WILLNEED );
+	  advised += CHAIN_SEGMENT;
+	}
+	nresident += (0 == stamps[s]);
+	stamps[s]  = clock;
+      }
+
+      // evict the least recently touched segments, their changes are written to the file by the kernel
+      while( resident < nresident*(size_t)CHAIN_SEGMENT )
+      {
+	size_t oldest = stamps.size();
+	for( size_t s = 0; s < stamps.size(); s++ )
+	  if( (0 < stamps[s]) && (stamps[s] < clock) && ((oldest == stamps.size()) || (stamps[s] < stamps[oldest])) )
+	    oldest = s;
+	if( oldest == stamps.size() )
+	  break;
+	madvise( segment( oldest ), segmentBytes( oldest ), MADV_DONTNEED );
+	stamps[oldest] = 0;
+	nresident--;
+      }
+    }
+
+  private:
+
+    // no copies of the mapping
+    chainStore( const chainStore & );
+    chainStore &operator=( const chainStore & );
+
+    // map the bytes afirst upto alast of the store, from the allocator or from the file when it is disk-backed
+    bool map( const size_t afirst, const size_t alast )
+    {
+      if( alast <= afirst )
+	return true;
+      if( file < 0 )
+	return allocator->commit( (char*)elements+afirst, alast-afirst );
+      if( 0 != ftruncate( file, alast ) )
+	return false;
+      return MAP_FAILED != mmap( (char*)elements+afirst, alast-afirst, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, file, afirst );
+    }
+
+    // the start and the number of bytes of segment as
+    char *segment( const size_t as ) const
+    {
+      return (char*)elements + as*CHAIN_SEGMENT;
+    }
+
+    size_t segmentBytes( const size_t as ) const
+    {
+      return min( (size_t)CHAIN_SEGMENT, bytes-as*CHAIN_SEGMENT );
+    }
+
+    T              *elements;  // the reserved address space
+    size_t          count;     // the number of elements
+    size_t          capacity;  // the number of elements that fit in the mapping
+    size_t          bytes;     // the number of bytes in use, a multiple of the segment size
+    size_t          reserved;  // the number of bytes of the reserved address space
+    chainAllocator *allocator; // the source of the memory of the segments of an anonymous store
+    int             file;      // the backing file, -1 for anonymous memory
+    size_t          resident;  // the number of bytes of the backing file that are kept in memory
+    size_t          nresident; // the number of segments in memory
+    size_t          clock;     // the number of touches so far
+    vector<size_t>  stamps;    // the touch at which each segment was last touched, 0 when it is not in memory
+};
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef FIELDSCANNER_HPP
+#define FIELDSCANNER_HPP
+
+#include <cstdlib>
+
+
+
+//
+// allocation-free scanning of the whitespace separated fields of a g2o line
+// the scanners take a cursor into the line and the end of the line, on success
+// the cursor is moved past the field, on failure it is left untouched
+// the line has to be followed by a character that is not part of a number, e.g. a newline
+//
+
+
+
+//
+// exact powers of ten in single precision, i.e. 10^k for k = 0..10 (5^10 < 2^24)
+//
+static const float scanPow10[11] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+
+
+
+//
+// skip spaces and tabs, returns false at the end of the line
+//
+inline bool scanSpace( const char *&anext, const char *alast )
+{
+   while( (anext < alast) && ((*anext == ' ') || (*anext == '\t') || (*anext == '\r')) )
+     anext++;
+   return anext < alast;
+}
+
+
+
+//
+// skip a field, e.g. the tag of a line
+//
+inline bool scanSkip( const char *&anext, const char *alast )
+{
+   if( !scanSpace( anext, alast ) )
+     return false;
+   while( (anext < alast) && (*anext != ' ') && (*anext != '\t') && (*anext != '\r') )
+     anext++;
+   return true;
+}
+
+
+
+//
+// convert a decimal integer field
+//
+inline bool scanInt( const char *&anext, const char *alast, int &avalue )
+{
+   const char *p = anext;
+   if( !scanSpace( p, alast ) )
+     return false;
+   bool negative = (*p == '-');
+   if( (*p == '-') || (*p == '+') )
+     p++;
+   const char *digits = p;
+   int         value  = 0;
+   while( (p < alast) && ((unsigned)(*p-'0') < 10) )
+     value = 10*value + (*p++ - '0');
+   if( p == digits )
+     return false;
+   avalue = negative ? -value : value;
+   anext  = p;
+   return true;
+}
+
+
+
+//
+// convert a decimal floating point field, the result equals that of strtof
+// fields whose digits fit a float exactly (below 2^24) and with a decimal exponent upto 10 are
+// converted with a single exactly rounded float multiplication or division, as both operands
+// are exact floats, all other fields (many digits, tiny or huge numbers, nan, inf) use strtof
+//
+inline bool scanFloat( const char *&anext, const char *alast, float &avalue )
+{
+   const char *p = anext;
+   if( !scanSpace( p, alast ) )
+     return false;
+   const char *start = p;
+
+   // sign, digits and fraction
+   bool     negative = (*p == '-');
+   if( (*p == '-') || (*p == '+') )
+     p++;
+   unsigned mantissa = 0;
+   int      ndigits  = 0;
+   int      exponent = 0;
+   bool     any      = false;
+   while( (p < alast) && ((unsigned)(*p-'0') < 10) )
+   {
+     if( (0 < ndigits) || (*p != '0') )
+     {
+       if( ndigits < 9 )
+	 mantissa = 10*mantissa + (*p-'0');
+       else
+	 exponent++;
+       ndigits++;
+     }
+     any = true;
+     p++;
+   }
+   if( (p < alast) && (*p == '.') )
+   {
+     p++;
+     while( (p < alast) && ((unsigned)(*p-'0') < 10) )
+     {
+       if( (0 < ndigits) || (*p != '0') )
+       {
+	 if( ndigits < 9 )
+	 {
+	   mantissa = 10*mantissa + (*p-'0');
+	   exponent--;
+	 }
+	 ndigits++;
+       }
+       else
+	 exponent--;
+       any = true;
+       p++;
+     }
+   }
+
+   // exponent
+   if( any && (p < alast) && ((*p == 'e') || (*p == 'E')) )
+   {
+     const char *q   = p+1;
+     bool        eneg = (q < alast) && (*q == '-');
+     if( (q < alast) && ((*q == '-') || (*q == '+')) )
+       q++;
+     if( (q < alast) && ((unsigned)(*q-'0') < 10) )
+     {
+       int e = 0;
+       while( (q < alast) && ((unsigned)(*q-'0') < 10) )
+       {
+	 if( e < 10000 )
+	   e = 10*e + (*q-'0');
+	 q++;
+       }
+       exponent += eneg ? -e : e;
+       p = q;
+     }
+   }
+
+   // fast path, exactly rounded, the field has to end here (e.g. no hexadecimal notation)
+   bool ends = (p == alast) || (*p == ' ') || (*p == '\t') || (*p == '\r') || (*p == '\n');
+   if( any && ends && (ndigits <= 9) && (mantissa < (1u << 24)) && (-10 <= exponent) && (exponent <= 10) )
+   {
+     float value = (float)mantissa;
+     value = (exponent < 0) ? value/scanPow10[-exponent] : value*scanPow10[exponent];
+     avalue = negative ? -value : value;
+     anext  = p;
+     return true;
+   }
+
+   // slow path, e.g. for many digits, tiny or huge numbers, nan and inf
+   char  *end;
+   float  value = strtof( start, &end );
+   if( (end == start) || (alast < end) )
+     return false;
+   avalue = value;
+   anext  = end;
+   return true;
+}
+
+#endif
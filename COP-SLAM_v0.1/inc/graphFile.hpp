@@ -0,0 +1,135 @@
+#ifndef GRAPHFILE_HPP
+#define GRAPHFILE_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+
+
+using namespace std;
+
+
+
+// types of the lines of a g2o file
+#define LINE_OTHER       0
+#define LINE_VERTEX_SE3  1
+#define LINE_VERTEX_RST3 2
+#define LINE_VERTEX_RT3  3
+#define LINE_EDGE_SE3    4
+#define LINE_EDGE_RST3   5
+#define LINE_EDGE_RT3    6
+
+// solution spaces of a graph
+#define SPACE_SE3  1
+#define SPACE_SIM3 2
+#define SPACE_RT3  3
+
+// binary graph files start with this magic, followed by the version of the layout
+#define BINARY_MAGIC   "COPGRAPH"
+#define BINARY_VERSION 1
+
+
+
+//
+// a vertex as stored in a g2o line, i.e. the translation, the quaternion (x,y,z,w) and the scale
+//
+struct vertexRecord {
+  float t[3];
+  float q[4];
+  float s;
+};
+
+
+
+//
+// an edge as stored in a g2o line, with the 21 upper triangular entries of the information
+// matrix packed row by row and the translation and rotation weights derived from them
+// the layout is that of the binary file, i.e. 144 bytes with the weights 8-byte aligned
+//
+struct edgeRecord {
+  int32_t start;
+  int32_t end;
+  float   t[3];
+  float   q[4];
+  float   s;
+  double  tra;
+  double  rot;
+  float   info[21];
+  float   pad;
+};
+
+
+
+//
+// header of a binary graph file, all fields are little-endian
+// the vertices follow the header, the edges (relative poses and loop closures in file order) follow the vertices
+//
+struct binaryHeader {
+  char     magic[8];     // BINARY_MAGIC
+  uint32_t version;      // BINARY_VERSION
+  uint32_t space;        // SPACE_SE3, SPACE_SIM3 or SPACE_RT3
+  uint64_t nvertices;    // number of vertex records
+  uint64_t nedges;       // number of edge records
+  uint64_t vertexOffset; // byte offset of the first vertex record
+  uint64_t edgeOffset;   // byte offset of the first edge record
+  uint32_t recordSizes;  // sizeof(vertexRecord) << 16 | sizeof(edgeRecord)
+  uint32_t reserved[3];
+};
+
+
+
+//
+// the type of a g2o line of alength characters
+//
+int graphLine( const char *aline, const size_t alength );
+
+
+
+//
+// the solution space of a line type, zero for lines that are not a vertex or an edge
+//
+int graphSpace( const int atype );
+
+
+
+//
+// scan a vertex or edge line from afirst upto alast into a record, an edge or vertex without scale has unit scale
+// the line has to be followed by a character that is not part of a number, e.g. a newline
+// the weights of an edge are not computed
+//
+bool scanVertex( const char *afirst, const char *alast, vertexRecord &arecord );
+bool scanEdge(   const char *afirst, const char *alast, edgeRecord &arecord );
+
+
+
+//
+// read-only view of a binary graph in memory, e.g. a mapped file
+// the records are used in place, nothing is copied
+//
+class binaryGraph {
+
+  public:
+
+    binaryGraph( const char *adata, const size_t asize ); // view of asize bytes at adata
+
+    static bool isBinary( const char *adata, const size_t asize ); // does the data start with the magic
+
+    bool                good(      void ) const; // is the data a complete binary graph of this version and layout
+    int                 space(     void ) const; // the solution space
+    size_t              nvertices( void ) const; // the number of vertices
+    size_t              nedges(    void ) const; // the number of edges
+    const vertexRecord *vertices(  void ) const; // the vertices
+    const edgeRecord   *edges(     void ) const; // the edges
+
+    // write a binary graph file, returns false when it cannot be written
+    static bool write( const string &aname, const int aspace, const vector<vertexRecord> &avertices, const vector<edgeRecord> &aedges );
+
+  private:
+
+    const binaryHeader *header; // the header, zero when the data is not valid
+    const char         *data;   // the data
+};
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef GZIPSTREAM_HPP
+#define GZIPSTREAM_HPP
+
+#include <streambuf>
+#include <vector>
+#include <cstddef>
+#include <zlib.h>
+
+
+
+using namespace std;
+
+
+
+// number of bytes that is compressed or decompressed at a time
+#define GZIP_BLOCK (1 << 16)
+
+// compression level of gzip output, the fastest level since the output is compressed while it is written
+#define GZIP_LEVEL 1
+
+
+
+//
+// does the data start with the gzip magic
+//
+bool isGzip( const char *adata, const size_t asize );
+
+
+
+//
+// decompress asize bytes of gzip data, possibly of several concatenated members, into acontents
+// returns false when the data is corrupt or truncated
+//
+bool gunzip( const char *adata, const size_t asize, vector<char> &acontents );
+
+
+
+//
+// input stream buffer that decompresses gzip data read from another stream buffer, e.g. of a pipe
+// only the compressed data that is available is read, such that lines are handed over as soon as they arrive
+//
+class gzipInBuf: public streambuf {
+
+  public:
+
+    gzipInBuf( streambuf *asource ); // constructor, decompresses the data of asource
+    ~gzipInBuf();                    // destructor
+
+    bool good( void ) const;         // is the data read so far valid and, at its end, complete
+
+  protected:
+
+    int_type   underflow( void );    // decompress the next block
+    streamsize showmanyc( void );    // is there compressed data available
+
+  private:
+
+    // no copies of the stream state
+    gzipInBuf( const gzipInBuf & );
+    gzipInBuf &operator=( const gzipInBuf & );
+
+    streambuf    *source; // the compressed data
+    z_stream      stream; // the state of the decompression
+    vector<char>  in;     // compressed data
+    vector<char>  out;    // decompressed data
+    bool          ended;  // is the last member complete
+    bool          failed; // is the data corrupt or truncated
+};
+
+
+
+//
+// output stream buffer that compresses the data in gzip format and writes it to another stream buffer
+// a flush of the stream writes all data so far such that it can be decompressed by a reader
+//
+class gzipOutBuf: public streambuf {
+
+  public:
+
+    gzipOutBuf( streambuf *atarget, const int alevel = GZIP_LEVEL ); // constructor, compresses into atarget
+    ~gzipOutBuf();                                                    // destructor, finishes the data
+
+    bool close( void );                 // finish the data, returns false when it could not be written
+
+  protected:
+
+    int_type overflow( int_type ac );   // compress the buffer and store ac
+    int      sync( void );              // compress and flush the buffer
+
+  private:
+
+    // no copies of the stream state
+    gzipOutBuf( const gzipOutBuf & );
+    gzipOutBuf &operator=( const gzipOutBuf & );
+
+    bool compress( const int aflush );  // compress the buffer with the given zlib flush mode
+
+    streambuf    *target; // the compressed data
+    z_stream      stream; // the state of the compression
+    vector<char>  in;     // data to compress
+    vector<char>  out;    // compressed data
+    bool          closed; // is the data finished
+    bool          failed; // could the data not be compressed or written
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef INFOTABLE_HPP
+#define INFOTABLE_HPP
+
+#include <vector>
+#include <stdint.h>
+
+
+
+using namespace std;
+
+
+
+//
+// table of distinct information matrices, each given by its 21 upper triangular values packed row by row
+// front-ends tend to use the same few matrices for all poses, the chain stores an index per pose instead
+// of a copy, and the weights are computed once per distinct matrix
+// the values are compared bit by bit, e.g. 0 and -0 are different entries
+//
+class infoTable {
+
+  public:
+
+    infoTable( void );
+
+    void   clear( void );        // remove all entries
+    int    size(  void ) const;  // the number of entries
+    void   reserve( const int an );  // make sure an entries can be inserted without allocating
+
+    // the index of the entry with the values at ainfo, a new entry is added when there is none
+    // the weights of new entries are computed by weigh() or given with the values
+    int    insert( const float *ainfo );
+    int    insert( const float *ainfo, const double atra, const double arot );
+    void   weigh( void );        // compute the weights of the entries added without weights, in one batch
+
+    const float *info( const int an ) const; // the 21 values of entry an
+    double       tra(  const int an ) const; // the translation weight of entry an
+    double       rot(  const int an ) const; // the rotation weight of entry an
+
+  private:
+
+    // an entry, the layout is that of the batches of the weight kernel
+    struct entry {
+      float    info[21];
+      uint32_t hash;
+      double   tra;
+      double   rot;
+    };
+
+    static uint32_t hashInfo( const float *ainfo ); // hash of the bits of the values
+    void            grow(     void );               // double the number of slots
+
+    vector<entry> entries;  // the entries in order of insertion
+    vector<int>   slots;    // open addressing hash table of entry indices, -1 is empty
+    int           weighted; // the number of entries with weights
+};
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef LIEKERNELS_HPP
+#define LIEKERNELS_HPP
+
+#include <cmath>
+#include <limits>
+#include <Eigen/Eigen>
+
+
+
+//
+// closed-form kernels on SO(3) and SE(3) used by the interpolation passes
+// all rotations of one loop closure share a single unit axis, such that the
+// kernels take the cosine and sine of the angle instead of the angle itself
+// and a rotation or a rotated vector costs no more than one sincos
+//
+
+
+
+//
+// exponential map of SO(3), i.e. Rodrigues' formula R = c*I + s*[a]x + (1-c)*a*a'
+// with a the unit axis, aaT = a*a' and c, s the cosine and sine of the angle
+// angles with a square below the smallest normal number, e.g. the steps of poses with weights
+// that decayed over many loop closures, give the exact identity to avoid denormal arithmetic
+//
+template<typename T>
+inline void so3Exp( const Eigen::Matrix<T,3,1> &aaxis, const Eigen::Matrix<T,3,3> &aaT, const T ac, const T as, Eigen::Matrix<T,3,3> &aR )
+{
+   if( !(as*as >= std::numeric_limits<T>::min()) && (T(0) < ac) )
+   {
+      aR.setIdentity();
+      return;
+   }
+   const T omc = T(1)-ac;
+   aR = aaT*omc;
+   aR(0,0) += ac;           aR(0,1) -= as*aaxis(2); aR(0,2) += as*aaxis(1);
+   aR(1,0) += as*aaxis(2);  aR(1,1) += ac;          aR(1,2) -= as*aaxis(0);
+   aR(2,0) -= as*aaxis(1);  aR(2,1) += as*aaxis(0); aR(2,2) += ac;
+}
+
+
+
+//
+// rotate a vector with the exponential map of SO(3) without forming the matrix, i.e.
+// R*v = c*v + s*(a x v) + (1-c)*(a'*v)*a
+// with axv = a x v and adotv = a'*v precomputed, since v is often the same for all poses
+//
+template<typename T>
+inline Eigen::Matrix<T,3,1> so3Rotate( const Eigen::Matrix<T,3,1> &aaxis, const Eigen::Matrix<T,3,1> &av, const Eigen::Matrix<T,3,1> &aaxv, const T aadotv, const T ac, const T as )
+{
+   return ac*av + as*aaxv + ((T(1)-ac)*aadotv)*aaxis;
+}
+
+
+
+//
+// logarithmic map of SO(3), i.e. the unit axis and the angle in [0,pi] of a rotation
+// the axis is taken from the skew-symmetric part, close to a half turn it is taken
+// from the symmetric part instead, close to identity the x-axis is returned
+//
+template<typename T>
+inline void so3Log( const Eigen::Matrix<T,3,3> &aR, Eigen::Matrix<T,3,1> &aaxis, T &aangle )
+{
+   // sin(angle)*axis and cos(angle)
+   Eigen::Matrix<T,3,1> v( T(0.5)*(aR(2,1)-aR(1,2)), T(0.5)*(aR(0,2)-aR(2,0)), T(0.5)*(aR(1,0)-aR(0,1)) );
+   T c = T(0.5)*(aR.trace()-T(1));
+   T s = v.norm();
+   aangle = std::atan2( s, c );
+
+   // regular case
+   if( (c > T(0)) || (s > T(1e-2)) )
+   {
+      if( s > T(0) )
+	aaxis = v*(T(1)/s);
+      else
+	aaxis << T(1), T(0), T(0);
+      return;
+   }
+
+   // close to a half turn (1-c)*a*a' = (R+R')/2 - c*I
+   Eigen::Matrix<T,3,3> B = T(0.5)*(aR+aR.transpose());
+   B.diagonal().array() -= c;
+   int k;
+   B.diagonal().maxCoeff( &k );
+   aaxis = B.col(k);
+   aaxis.normalize();
+   if( aaxis.dot(v) < T(0) )
+     aaxis = -aaxis;
+}
+
+
+
+//
+// walk along a rotation axis with increasing absolute angles, such that each step
+// costs one sincos: the cosine and sine of the step from the previous angle follow
+// from the angle difference formulas, the current angle becomes the next previous angle
+//
+template<typename T>
+class so3Walk {
+
+  public:
+
+    T c; // cosine of the current angle
+    T s; // sine of the current angle
+
+    // start at angle zero
+    so3Walk( void ) : c(T(1)), s(T(0)) {}
+
+    // start at an absolute angle
+    explicit so3Walk( const T aangle ) : c(std::cos( aangle )), s(std::sin( aangle )) {}
+
+    // go to an absolute angle, return the cosine and sine of the step
+    inline void stepTo( const T aangle, T &acstep, T &asstep )
+    {
+      const T cn = std::cos( aangle );
+      const T sn = std::sin( aangle );
+      acstep = cn*c + sn*s;
+      asstep = sn*c - cn*s;
+      c      = cn;
+      s      = sn;
+    }
+};
+
+#endif
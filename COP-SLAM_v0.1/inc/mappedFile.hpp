@@ -0,0 +1,43 @@
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+
+
+using namespace std;
+
+
+
+//
+// read-only view of the contents of a file
+// regular files are mapped into memory, other files (e.g. pipes) are read into a buffer
+// gzip compressed files are decompressed into a buffer
+//
+class mappedFile {
+  
+  public:
+    
+    mappedFile( const string &aname ); // constructor, maps or reads the file
+    ~mappedFile();                     // destructor, unmaps the file
+    
+    bool        good( void ) const; // is the file opened
+    const char *data( void ) const; // the contents of the file
+    size_t      size( void ) const; // the number of bytes
+    
+  private:
+    
+    // no copies of the mapping
+    mappedFile( const mappedFile & );
+    mappedFile &operator=( const mappedFile & );
+    
+    const char   *buffer; // the contents
+    size_t        length; // the number of bytes
+    bool          mapped; // is the buffer a mapping
+    bool          opened; // is the file opened
+    vector<char>  copy;   // the contents when the file cannot be mapped or is compressed
+};
+
+#endif
@@ -10,6 +10,11 @@
 #include <Eigen/Geometry>
 #include <Eigen/StdVector>
 #include <Eigen/Core>
+#include "poseTypes.hpp"
+#include "threadPool.hpp"
+#include "weightTree.hpp"
+#include "chainStore.hpp"
+#include "infoTable.hpp"
 
 
 using namespace std;
@@ -22,21 +27,90 @@ using namespace std;
 #define BOTH        1
 #define ROTATION    2
 #define TRANSLATION 3
-#define SCALE       4
+
+// number of poses of which the interpolated rotations are computed at once in a sweep
+#define SWEEP_TILE 64
+
+// default number of poses below which a range of the chain is processed by one thread
+#define PARALLEL_THRESHOLD 4096
+
+// default motion below which consecutive relative poses are merged by sparsifyChain, i.e. a stationary or slow
+// stretch of the chain, in the units of the translations and in radians
+#define SPARSE_DISTANCE 0.05
+#define SPARSE_ANGLE    0.005
+
+
+//
+// numerical settings that depend on the scalar type in which the chain is stored
+// normalizeInterval = number of loop closures between re-orthonormalizations of the relative rotations,
+//                     zero when rounding errors are small enough to never require it
+//
+template<typename T>
+struct chainScalar
+{
+  static const int normalizeInterval = 0;
+};
+
+template<>
+struct chainScalar<float>
+{
+  static const int normalizeInterval = 100;
+};
+
 
 
 //
-// class to store the vector of Eigen 4x4f matrices with basic operations
+// class to store the vectors of compact poses with basic operations
+// Storage is the scalar type in which the poses are stored
+// Accum   is the scalar type in which poses are interpolated, updated and integrated
+// explicit instantiations exist for <float,float>, <double,double> and <float,double>
 //
+template<typename Storage, typename Accum = Storage>
 class poseChain {
   
   public:
     
+    // pose and matrix types for storage and computation
+    typedef se3PoseT<Storage>                                   se3Store;
+    typedef sim3PoseT<Storage>                                  sim3Store;
+    typedef Eigen::Matrix<Storage,3,1>                          vector3Store;
+    typedef se3PoseT<Accum>                                     se3Accum;
+    typedef sim3PoseT<Accum>                                    sim3Accum;
+    typedef Eigen::Matrix<Accum,3,1>                            vector3Accum;
+    typedef Eigen::Matrix<Accum,3,3>                            matrix3Accum;
+    
     poseChain(); // constructor
     
     void syncChain( void ); // make sure internal variables are updated
     int  size(      void ); // return the number of poses (not the size of the std vector)
-    void copSLAM(   void ); // run COP-SLAM on the pose chain
+    void copSLAM(   void ); // run COP-SLAM on the pose chain, i.e. process all loop closures that were not processed yet
+    
+    // keep the poses in files in adirectory instead of in memory, of which at most aresident bytes stay in memory
+    // the ranges of the chain are paged in when a loop closure or the integration reaches them
+    bool setStore( const string &adirectory, const size_t aresident = CHAIN_RESIDENT );
+    
+    // the allocator of the segments of all stores of the chain (see chainAllocator.hpp), set before the chain grows
+    void setAllocator( chainAllocator &aallocator );
+    
+    // size the chain for aposes absolute poses, aclosures loop closures and ainfos distinct information matrices,
+    // after which the chain is in its steady state: adding poses and loop closures within these sizes does not
+    // allocate heap memory, which is checked when built with ALLOCATION_CHECK
+    void presize( const int aposes, const int aclosures, const int ainfos );
+    
+    // optional compaction of a loaded chain before running COP-SLAM: each run of consecutive relative poses that
+    // together move less than adistance and turn less than aangle is merged into one relative pose with the summed
+    // weights, the poses of the loop closures are kept, returns the number of absolute poses that were removed
+    // expandChain restores the original poses afterwards, those that were removed are interpolated between the
+    // kept poses by their weights, the original relative poses and information values are not changed
+    int  sparsifyChain( const Accum adistance = SPARSE_DISTANCE, const Accum aangle = SPARSE_ANGLE );
+    void expandChain(   void );
+    
+    // online use, storage grows amortized and each loop closure is processed immediately
+    // the absolute poses are correct after every call, addLoopClosure returns the first absolute pose
+    // that was corrected (all later poses are corrected as well) or size() when nothing changed
+    void startChain(      const sim3Store &aorigin ); // start a new chain at the first absolute pose
+    int  addRelativePose( const se3Store &apose, const Eigen::Matrix<float,6,6> &ainfo ); // append a relative pose, returns the index of the new absolute pose
+    int  addLoopClosure(  const int astart, const int aend, const se3Store &apose, const Eigen::Matrix<float,6,6> &ainfo, const Storage ascale = Storage(1) ); // pose aend in the frame of pose astart
     
     // identifier of the method to be used for optimization
     int method;    
@@ -50,8 +124,18 @@ class poseChain {
     // the number of loop closures
     int nclosures;
     
+    // the number of loop closures that have been processed
+    int nprocessed;
+    
+    // the absolute poses upto integrated are up-to-date, prevEnd is the end of the last closed loop
+    int integrated;
+    int prevEnd;
+    
+    // the number of loop closures since the last orthonormalization of the relative rotations
+    int doNormalize;
+    
     // how much of the update should be processed
-    float globalNormalizer;
+    Accum globalNormalizer;
     
     
     // is true when solution space includes scaling
@@ -61,53 +145,114 @@ class poseChain {
     bool ignore_sim3_solution_space;
     
     
-    // stl vector of Eigen 4x4f matrices to store relative and absolute poses
-    // poseVector[n]   = absolute pose
-    // poseVector[n+1] = relative pose
-    // poseVector[n+2] = not yet used
-    // poseVector[n+3] = updates
-    // poseVector[n+4] = next absolute pose
-    // etc...
-    vector<Eigen::Affine3f,Eigen::aligned_allocator<Eigen::Affine3f> > poseVector;
+    // stores of compact poses to store relative and absolute poses, in memory or disk-backed (see setStore)
+    // the hot stores used by the kernels are kept separate and contiguous
+    // all stores of the chain grow in place, appends never copy the chain and the addresses of its elements are stable
+    // absVector[n]  = absolute pose n, its scale is the scale estimate of pose n
+    // relVector[n]  = relative pose from n-1 to n (identity for n = 0)
+    // the updates of the relative poses are never stored, they are computed per pose in a sweep
+    chainStore<sim3Store> absVector;
+    chainStore<sim3Store> relVector;
     
-    // matrix to store scale factors
-    Eigen::MatrixXf scaleVector;
+    // cold copy of the original relative poses, only used when writing the output
+    // origVector[n] = original relative pose from n-1 to n
+    chainStore<se3Store> origVector;
     
-    // stl vector of Eigen 4x4f matrices to loop closure poses
-    vector<Eigen::Affine3f,Eigen::aligned_allocator<Eigen::Affine3f> > closeVector;
+    // store of compact poses to store loop closure poses
+    // the scale of a loop closure is the loop-closing scale when solution space includes scale
+    chainStore<sim3Store> closeVector;
     
     // scale compensations when solutions space includes scale
-    Eigen::MatrixXf scaleCloseVector;
-    float scaleCloseFactor;
-    float scaleNormalizer;
-    
-    // matrices of floats representing the information value (inverse of variance) of each relative pose
-    Eigen::MatrixXf traInfoVector;
-    Eigen::MatrixXf rotInfoVector;
-    Eigen::MatrixXf scaleInfoVector;
-    Eigen::MatrixXf traCloseInfoVector;
-    Eigen::MatrixXf rotCloseInfoVector;
+    Accum scaleCloseFactor;
+    Accum scaleNormalizer;
+    
+    // information value (inverse of variance) of each relative pose
+    // segment trees, such that the sums and decreases of the weights of a loop do not depend on its length
+    weightTree<Accum> traInfoVector;
+    weightTree<Accum> rotInfoVector;
+    weightTree<Accum> scaleInfoVector;
+    
+    // information value of each loop closure
+    chainStore<Accum> traCloseInfoVector;
+    chainStore<Accum> rotCloseInfoVector;
         
-    // matrix to store the original information value
-    // these are used when writing the output, such that g2o can take over properly
-    Eigen::MatrixXf infoVector;
-    Eigen::MatrixXf infoCloseVector;
+    // the original information values, these are used when writing the output, such that g2o can take over properly
+    // each distinct matrix is stored once with its weights, the poses and loop closures hold the index of their matrix
+    infoTable       infos;
+    chainStore<int> infoIndexVector;
+    chainStore<int> infoCloseIndexVector;
     
-    // stl vector of ints representing the start and end of loop closures
-    std::vector<int> startVector;
-    std::vector<int> endVector;
+    // store of ints representing the start and end of loop closures
+    chainStore<int> startVector;
+    chainStore<int> endVector;
+    
+    // the original index of each absolute pose of a sparsified chain, empty when the chain is not sparsified
+    // absolute pose k merges the relative poses after sparseIndex[k-1] upto sparseIndex[k], the loop closures
+    // refer to the absolute poses of the sparsified chain while origVector and infoIndexVector keep the original chain
+    chainStore<int> sparseIndex;
+    
+    // threads for long ranges of the chain and the number of poses below which a range is processed serially
+    threadPool pool;
+    int        parallelThreshold;
+    
+    // is the chain in its steady state, i.e. are heap allocations by the chain an error (see presize)
+    bool steady;
     
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    
+    // the interpolation of one loop-closure update, shared by all poses of the loop
+    struct loopUpdate {
+      sim3Accum    desired;       // desired pose of the loop closure
+      vector3Accum axis;          // rotation axis of the update expressed in the frame of the desired pose
+      matrix3Accum axisaxis;      // axis*axis'
+      Accum        angle;         // rotation angle of the update
+      vector3Accum tra;           // translation of the update expressed in the frame of the desired pose
+      vector3Accum axistra;       // axis x tra
+      Accum        axisdottra;    // axis'*tra
+      Accum        traNormalizer; // sum of the translation weights
+      Accum        rotNormalizer; // sum of the rotation weights
+      int          start;         // the pose at which the loop starts
+      bool         scale;         // also pre-multiply the relative poses with their share of the scale correction
+    };
         
     // basic operations on pose chains
-    Eigen::Vector3f interpolateMotion( Eigen::Affine3f adesired, Eigen::Affine3f aerror, const int aclosure, const int astart, const int aend ); // interpolate the update motion
-    Eigen::Vector3f interpolateTra(    Eigen::Affine3f adesired, Eigen::Affine3f aerror, const int aclosure, const int astart, const int aend ); // interpolate the update tranlation
-    Eigen::Vector3f interpolateRot(    Eigen::Affine3f adesired, Eigen::Affine3f aerror, const int aclosure, const int astart, const int aend ); // interpolate the update rotation
-    void integrateChain(           const int astart, const int aend, const bool aidentity ); // (re-)compute absolute poses from relative poses
-    void integrateChainNormalized( const int astart, const int aend, const bool normalize ); // (re-)compute absolute poses from relative poses
-    void cobChain(                 const int astart, const int aend, const int  method );    // apply the change of basis to the updates 
-    void updateChain(              const int astart, const int aend, const int  method );    // update the relative poses 
+    // the close functions interpolate a loop-closure update, apply the change of basis, update the relative poses
+    // and integrate the absolute poses in a single sweep over the loop, they return the normalizers of the weights
+    vector3Accum closeMotion(      const sim3Accum &aupdate, const sim3Accum &adesired, const int aclosure, const int astart, const int aend, const bool anormalize ); // update motions, absolute poses from absVector[astart]
+    vector3Accum closeRotation(    const sim3Accum &aupdate, const sim3Accum &adesired, const int aclosure, const int astart, const int aend, const bool ascale, const bool aidentity, const bool anormalize ); // update rotations (and scale)
+    vector3Accum closeTranslation( const sim3Accum &aupdate, const sim3Accum &adesired, const int aclosure, const int astart, const int aend, const bool anormalize ); // update translations, absolute poses from absVector[astart]
+    void integrateChain( const int astart, const int aend, const bool aidentity ); // (re-)compute absolute poses from relative poses
+    bool processClosure( const int aclosure ); // run COP-SLAM for one loop closure, returns false when the loop is not closed
+    
+    // mean translation and rotation variance of an information matrix, i.e. the weights of a pose
+    static void infoWeights( const Eigen::Matrix<float,6,6> &ainfo, Accum &atra, Accum &arot );
+    
+    // the same for a batch of an matrices given by their 21 packed upper triangular values, the values of
+    // matrix k start at ainfo and its weights are stored at atra and arot, all advanced by k*astride bytes
+    static void infoWeights( const size_t an, const size_t astride, const float *ainfo, double *atra, double *arot );
+    
+  protected:
+    
+    // the index of an information matrix in the table of distinct matrices, with its weights computed
+    int internInfo( const Eigen::Matrix<float,6,6> &ainfo );
     
   private:
+    
+    // sweep over a loop, in parallel chunks for long loops, returns the product of the scale corrections
+    Accum sweepChain(       const int amethod, const loopUpdate &aloop, const int astart, const int aend, const bool aidentity, const bool anormalize );
+    
+    // update the relative poses afirst upto alast, and integrate them onto apose, the absolute poses are only written when astore is true
+    Accum sweepMotion(      const loopUpdate &aloop, const int afirst, const int alast, sim3Accum &apose, const bool astore, const bool anormalize );
+    Accum sweepRotation(    const loopUpdate &aloop, const int afirst, const int alast, sim3Accum &apose, const bool astore, const bool anormalize );
+    Accum sweepTranslation( const loopUpdate &aloop, const int afirst, const int alast, sim3Accum &apose, const bool astore, const bool anormalize );
+    
+    // integrate the chunks afirst[k] upto afirst[k+1] from the scan of the chunk products in aprefix
+    void integrateChunks( const vector<int> &afirst, vector<sim3Accum> &aprefix );
+    
+    // scratch of the parallel sweeps and integrations, kept such that they do not allocate once the pool is known
+    // chunk k holds the poses from chunkFirst[k] upto chunkFirst[k+1]
+    vector<int>       chunkFirst;
+    vector<sim3Accum> chunkPrefix;
+    vector<Accum>     chunkCorrections;
         
-};
\ No newline at end of file
+};
@@ -6,7 +6,12 @@
 #include <algorithm>
 #include <iterator>
 #include <vector>
+#include <memory>
+#include <cstring>
 #include "poseChain.hpp"
+#include "mappedFile.hpp"
+#include "graphFile.hpp"
+#include "gzipStream.hpp"
 
 
 
@@ -14,23 +19,76 @@ using namespace std;
 
 
 
+// size of the buffer of the output file
+#define WRITE_BUFFER (1 << 20)
+
+// number of lines of the output file that is formatted by one thread at a time
+#define WRITE_RANGE 4096
+
+// number of bytes of a g2o file that is parsed by one thread at a time
+#define PARSE_CHUNK (1 << 20)
+
+
+
 //
 // class to read and write pose files
+// poses are parsed and written in single precision and stored in the chain with its storage type
 //
-class poseIO: public poseChain 
+template<typename Storage, typename Accum = Storage>
+class poseIO: public poseChain<Storage,Accum> 
 {
   
   public:
     
+    // members of the pose chain
+    typedef poseChain<Storage,Accum> chain;
+    typedef typename chain::se3Store     se3Store;
+    typedef typename chain::sim3Store    sim3Store;
+    typedef typename chain::vector3Store vector3Store;
+    using chain::method;
+    using chain::naposes;
+    using chain::nposes;
+    using chain::nclosures;
+    using chain::se3_solution_space;
+    using chain::rt3_solution_space;
+    using chain::sim3_solution_space;
+    using chain::ignore_sim3_solution_space;
+    using chain::absVector;
+    using chain::relVector;
+    using chain::origVector;
+    using chain::closeVector;
+    using chain::traInfoVector;
+    using chain::rotInfoVector;
+    using chain::scaleInfoVector;
+    using chain::traCloseInfoVector;
+    using chain::rotCloseInfoVector;
+    using chain::infos;
+    using chain::infoIndexVector;
+    using chain::infoCloseIndexVector;
+    using chain::startVector;
+    using chain::endVector;
+    using chain::sparseIndex;
+    using chain::steady;
+    using chain::syncChain;
+    using chain::presize;
+    using chain::startChain;
+    using chain::addRelativePose;
+    using chain::addLoopClosure;
+    
     poseIO(); // constructor
     
     void setInputFile(  string aIFile  ); // the file which contains the graph
     void setOutputFile( string aOFile  ); // the file to write the optimized graph to
     void setMethod(     string aMethod ); // the name of the method to be used for optimization
+    void setLoadMode(   string aMode   ); // fast-load reads only the first vertex of a g2o file, full-load (default) reads all
     
     bool parseInputFile();  // parse the input graph from file
     bool writeOutputFile(); // write the optimized graph to the output file
     
+    // process a graph while it is being read, e.g. from a pipe, each loop closure is processed as soon as it is read
+    // every new absolute pose and every pose corrected by a loop closure is written as a vertex line to aOutput
+    bool streamGraph( istream &aInput, ostream &aOutput );
+    
     void printNPoses(    ostream &output ) const; // print the number of poses to output
     void printNAPoses(   ostream &output ) const; // print the number of absolute poses to output
     void printNClosures( ostream &output ) const; // print the number of loop clousures to output
@@ -40,6 +98,50 @@ class poseIO: public poseChain
     
   private:
         
-    string iFile; // the name of the input file
-    string oFile; // the name of the output file
+    string iFile;    // the name of the input file
+    string oFile;    // the name of the output file
+    bool   fastLoad; // read only the first vertex and derive the chain from the relative poses
+    
+    // the poses and the information matrix of the records of a g2o line or a binary graph
+    static sim3Store vertexPose( const vertexRecord &aVertex );
+    static se3Store  edgePose(   const edgeRecord &aEdge );
+    static void      edgeInfo(   const edgeRecord &aEdge, Eigen::Matrix<float,6,6> &aInfo );
+    
+    // the records of a part of a g2o file, parsed independently of the other parts
+    struct parseChunk {
+      const char           *first;       // the first line
+      const char           *last;        // the end of the last line
+      bool                  fastLoad;    // only the first vertex of the chunk is scanned
+      vector<vertexRecord>  vertices;    // the vertices in file order
+      vector<edgeRecord>    edges;       // the edges in file order
+      infoTable             infos;       // the distinct information matrices of the edges, with their weights
+      vector<int>           infoIndex;   // the index of the information matrix of each edge
+      int                   nlines;      // the number of non-empty lines
+      int                   nse3;        // the number of vertices of each type
+      int                   nsim3;
+      int                   nrt3;
+      int                   vertexSpace; // the solution space of the first vertex, zero when there is none
+      int                   edgeSpace;   // the solution space of the first edge, zero when there is none
+      bool                  failed;      // is there a line that could not be parsed
+      string                failedLine;  // the line that could not be parsed
+    };
+    
+    // build the chain while parsing
+    static void parseLines( parseChunk &aChunk ); // parse the lines of a chunk
+    bool parseBinary(  const binaryGraph &aGraph ); // load a binary graph
+    void clearChain(   void );                      // empty the chain
+    void reserveChain( const int an );              // make sure pose an can be stored
+    void storeEdge(    const edgeRecord &aEdge, const int aInfo );     // store a relative pose or a loop closure with information matrix aInfo
+    bool checkChain(   const long aLines, const int aSE3, const int aSIM3, const int aRT3 ); // set the solution space from the number of vertices of each type and check the number of poses
+    
+    // write the optimized graph as binary graph
+    bool writeBinaryFile( void );
+    
+    // write absolute pose n as a vertex line, relative pose n as an edge line followed by the loop closures ending in pose n
+    // the edges take the formatted values of the information matrices from aInfoText
+    void writeVertex( ostream &aOutput, const int an );
+    void writeEdges(  ostream &aOutput, const int an, const vector<int> &aClosureFirst, const vector<int> &aClosureOrder, const vector<string> &aInfoText );
+    
+    // index of the loop closures by their end pose
+    void closuresByEnd( vector<int> &aFirst, vector<int> &aOrder ) const;
 };
\ No newline at end of file
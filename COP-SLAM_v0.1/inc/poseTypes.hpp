@@ -0,0 +1,251 @@
+#ifndef POSETYPES_HPP
+#define POSETYPES_HPP
+
+#include <cmath>
+#include <Eigen/Eigen>
+#include <Eigen/Geometry>
+#include <Eigen/SVD>
+
+
+
+//
+// express the rotation aRot in the frame of the rotation aBasis, i.e. aBasis'*aRot*aBasis
+// this is done through the axis of aRot, such that the result remains a proper rotation
+// when rounding errors have made aBasis slightly non-orthonormal
+//
+template<typename T>
+inline Eigen::Matrix<T,3,3> rotationChangeOfBasis( const Eigen::Matrix<T,3,3> &aBasis, const Eigen::Matrix<T,3,3> &aRot )
+{
+   // sin(angle)*axis and cos(angle) of the rotation
+   Eigen::Matrix<T,3,1> v( T(0.5)*(aRot(2,1)-aRot(1,2)), T(0.5)*(aRot(0,2)-aRot(2,0)), T(0.5)*(aRot(1,0)-aRot(0,1)) );
+   T                    c  = T(0.5)*(aRot.trace()-T(1));
+   T                    vv = v.squaredNorm();
+
+   // close to a half turn the axis cannot be recovered from the skew part
+   if( !(T(1)+c > T(1e-3)) )
+     return aBasis.transpose()*aRot*aBasis;
+
+   // rotate the axis, keep the length of v
+   Eigen::Matrix<T,3,1> w  = aBasis.transpose()*v;
+   T                    ww = w.squaredNorm();
+   if( T(0) < ww )
+     w *= std::sqrt( vv/ww );
+
+   // Rodrigues' formula with (1-cos)*axis*axis' = w*w'/(1+cos)
+   Eigen::Matrix<T,3,3> result;
+   result.noalias() = w*w.transpose()*(T(1)/(T(1)+c));
+   result(0,0) += c;    result(0,1) -= w(2); result(0,2) += w(1);
+   result(1,0) += w(2); result(1,1) += c;    result(1,2) -= w(0);
+   result(2,0) -= w(1); result(2,1) += w(0); result(2,2) += c;
+   return result;
+}
+
+
+
+//
+// closest rotation to a 3x3 matrix in Frobenius sense (polar decomposition using an SVD)
+//
+template<typename T>
+inline Eigen::Matrix<T,3,3> closestRotation( const Eigen::Matrix<T,3,3> &aM )
+{
+   Eigen::JacobiSVD< Eigen::Matrix<T,3,3> > svd( aM, Eigen::ComputeFullU | Eigen::ComputeFullV );
+   T                    x = (svd.matrixU() * svd.matrixV().adjoint()).determinant();
+   Eigen::Matrix<T,3,3> m(svd.matrixU());
+   m.col(0) /= x;
+   return m * svd.matrixV().adjoint();
+}
+
+
+
+//
+// rigid pose, i.e. an element of SE(3) stored as a 3x3 rotation and a translation (3x4 matrix)
+// used instead of the 4x4 Eigen::Affine3f for pose-chain storage
+//
+template<typename T>
+class se3PoseT {
+
+  public:
+
+    typedef T                    Scalar;
+    typedef Eigen::Matrix<T,3,3> Matrix3;
+    typedef Eigen::Matrix<T,3,1> Vector3;
+
+    Matrix3 R; // rotation
+    Vector3 t; // translation
+
+    // constructors
+    se3PoseT( void ) {}
+    se3PoseT( const Matrix3 &aR, const Vector3 &at ) : R(aR), t(at) {}
+    explicit se3PoseT( const Eigen::Transform<T,3,Eigen::Affine> &aA ) : R(aA.linear()), t(aA.translation()) {}
+
+    // the identity pose
+    static se3PoseT Identity( void )
+    {
+      return se3PoseT( Matrix3::Identity(), Vector3::Zero() );
+    }
+
+    // composition, i.e. [R1 t1]*[R2 t2] = [R1*R2  R1*t2+t1]
+    inline se3PoseT operator*( const se3PoseT &aOther ) const
+    {
+      se3PoseT result;
+      result.R.noalias() = R*aOther.R;
+      result.t.noalias() = R*aOther.t;
+      result.t          += t;
+      return result;
+    }
+
+    // apply to a point
+    inline Vector3 operator*( const Vector3 &aPoint ) const
+    {
+      return R*aPoint + t;
+    }
+
+    // closed-form inverse, i.e. [R' -R'*t]
+    inline se3PoseT inverse( void ) const
+    {
+      se3PoseT result;
+      result.R           = R.transpose();
+      result.t.noalias() = -(result.R*t);
+      return result;
+    }
+
+    // the same pose with another scalar type
+    template<typename U>
+    inline se3PoseT<U> cast( void ) const
+    {
+      return se3PoseT<U>( R.template cast<U>(), t.template cast<U>() );
+    }
+
+    // closest rotation to R
+    inline Matrix3 rotation( void ) const
+    {
+      return closestRotation( R );
+    }
+
+    // re-orthonormalize the rotation
+    inline void normalize( void )
+    {
+      R = rotation();
+    }
+
+    // conversion to the 4x4 representation
+    inline Eigen::Transform<T,3,Eigen::Affine> affine( void ) const
+    {
+      Eigen::Transform<T,3,Eigen::Affine> result;
+      result.linear()      = R;
+      result.translation() = t;
+      result.makeAffine();
+      return result;
+    }
+};
+
+
+
+//
+// similarity pose, i.e. an element of SIM(3) stored as a rotation, a translation and a scale
+// it maps a point p to s*R*p+t, for SE(3) and RxT(3) solution spaces the scale stays 1
+//
+template<typename T>
+class sim3PoseT {
+
+  public:
+
+    typedef T                    Scalar;
+    typedef Eigen::Matrix<T,3,3> Matrix3;
+    typedef Eigen::Matrix<T,3,1> Vector3;
+
+    Matrix3 R; // rotation
+    Vector3 t; // translation
+    T       s; // scale
+
+    // constructors
+    sim3PoseT( void ) {}
+    sim3PoseT( const Matrix3 &aR, const Vector3 &at, const T as ) : R(aR), t(at), s(as) {}
+    sim3PoseT( const se3PoseT<T> &aPose, const T as ) : R(aPose.R), t(aPose.t), s(as) {}
+    explicit sim3PoseT( const se3PoseT<T> &aPose ) : R(aPose.R), t(aPose.t), s(T(1)) {}
+
+    // the identity pose
+    static sim3PoseT Identity( void )
+    {
+      return sim3PoseT( Matrix3::Identity(), Vector3::Zero(), T(1) );
+    }
+
+    // composition, i.e. [s1*R1 t1]*[s2*R2 t2] = [s1*s2*R1*R2  s1*R1*t2+t1]
+    inline sim3PoseT operator*( const sim3PoseT &aOther ) const
+    {
+      sim3PoseT result;
+      result.R.noalias() = R*aOther.R;
+      result.t.noalias() = R*aOther.t;
+      result.t           = s*result.t + t;
+      result.s           = s*aOther.s;
+      return result;
+    }
+
+    // composition with a rigid pose, i.e. [s*R1 t1]*[R2 t2] = [s*R1*R2  s*R1*t2+t1]
+    inline sim3PoseT operator*( const se3PoseT<T> &aOther ) const
+    {
+      sim3PoseT result;
+      result.R.noalias() = R*aOther.R;
+      result.t.noalias() = R*aOther.t;
+      result.t           = s*result.t + t;
+      result.s           = s;
+      return result;
+    }
+
+    // closed-form inverse, i.e. [R'/s -R'*t/s]
+    inline sim3PoseT inverse( void ) const
+    {
+      sim3PoseT result;
+      result.s           = T(1)/s;
+      result.R           = R.transpose();
+      result.t.noalias() = -(result.s*(result.R*t));
+      return result;
+    }
+
+    // the rigid motion this*aMotion*inverse(this), e.g. a motion expressed in another frame
+    inline se3PoseT<T> conjugate( const se3PoseT<T> &aMotion ) const
+    {
+      se3PoseT<T> result;
+      result.R.noalias() = R*aMotion.R*R.transpose();
+      result.t.noalias() = s*(R*aMotion.t) - result.R*t;
+      result.t          += t;
+      return result;
+    }
+
+    // the same pose with another scalar type
+    template<typename U>
+    inline sim3PoseT<U> cast( void ) const
+    {
+      return sim3PoseT<U>( R.template cast<U>(), t.template cast<U>(), U(s) );
+    }
+
+    // the rigid part, i.e. without scale
+    inline se3PoseT<T> rigid( void ) const
+    {
+      return se3PoseT<T>( R, t );
+    }
+
+    // closest rotation to R
+    inline Matrix3 rotation( void ) const
+    {
+      return closestRotation( R );
+    }
+
+    // re-orthonormalize the rotation
+    inline void normalize( void )
+    {
+      R = rotation();
+    }
+};
+
+
+
+// single precision poses, as used by the file parser and writer
+typedef se3PoseT<float>  se3Pose;
+typedef sim3PoseT<float> sim3Pose;
+
+// double precision poses
+typedef se3PoseT<double>  se3Posed;
+typedef sim3PoseT<double> sim3Posed;
+
+#endif
@@ -0,0 +1,451 @@
+#ifndef SIMDKERNELS_HPP
+#define SIMDKERNELS_HPP
+
+#include <cmath>
+#include <Eigen/Eigen>
+#include "poseTypes.hpp"
+#include "lieKernels.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSE4_1__
+#include <smmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+
+
+//
+// batched kernels that process several poses per instruction
+// the kernels are written once on top of a small set of float pack operations,
+// which exist for SSE4 (4 poses) and, when compiled with -mavx2, AVX2 (8 poses)
+// without SSE4 only the scalar versions of the kernels are available
+//
+
+
+
+#ifdef __SSE4_1__
+//
+// float pack operations for SSE4
+//
+struct ssePack
+{
+  typedef __m128 type;
+  static const int size = 4;
+  static inline type set1(   const float a )                          { return _mm_set1_ps( a ); }
+  static inline type load(   const float *a )                         { return _mm_loadu_ps( a ); }
+  static inline void store(  float *a, const type b )                 { _mm_storeu_ps( a, b ); }
+  static inline type add(    const type a, const type b )             { return _mm_add_ps( a, b ); }
+  static inline type sub(    const type a, const type b )             { return _mm_sub_ps( a, b ); }
+  static inline type mul(    const type a, const type b )             { return _mm_mul_ps( a, b ); }
+  static inline type div(    const type a, const type b )             { return _mm_div_ps( a, b ); }
+  static inline type floor(  const type a )                           { return _mm_floor_ps( a ); }
+  static inline type andnot( const type a, const type b )             { return _mm_andnot_ps( a, b ); }
+  static inline type xor_(   const type a, const type b )             { return _mm_xor_ps( a, b ); }
+  static inline type and_(   const type a, const type b )             { return _mm_and_ps( a, b ); }
+  static inline type eq(     const type a, const type b )             { return _mm_cmpeq_ps( a, b ); }
+  static inline type lt(     const type a, const type b )             { return _mm_cmplt_ps( a, b ); }
+  static inline type select( const type a, const type b, const type m ) { return _mm_blendv_ps( a, b, m ); } // m ? b : a
+};
+#endif
+
+
+
+#ifdef __AVX2__
+//
+// float pack operations for AVX2
+//
+struct avxPack
+{
+  typedef __m256 type;
+  static const int size = 8;
+  static inline type set1(   const float a )                          { return _mm256_set1_ps( a ); }
+  static inline type load(   const float *a )                         { return _mm256_loadu_ps( a ); }
+  static inline void store(  float *a, const type b )                 { _mm256_storeu_ps( a, b ); }
+  static inline type add(    const type a, const type b )             { return _mm256_add_ps( a, b ); }
+  static inline type sub(    const type a, const type b )             { return _mm256_sub_ps( a, b ); }
+  static inline type mul(    const type a, const type b )             { return _mm256_mul_ps( a, b ); }
+  static inline type div(    const type a, const type b )             { return _mm256_div_ps( a, b ); }
+  static inline type floor(  const type a )                           { return _mm256_floor_ps( a ); }
+  static inline type andnot( const type a, const type b )             { return _mm256_andnot_ps( a, b ); }
+  static inline type xor_(   const type a, const type b )             { return _mm256_xor_ps( a, b ); }
+  static inline type and_(   const type a, const type b )             { return _mm256_and_ps( a, b ); }
+  static inline type eq(     const type a, const type b )             { return _mm256_cmp_ps( a, b, _CMP_EQ_OQ ); }
+  static inline type lt(     const type a, const type b )             { return _mm256_cmp_ps( a, b, _CMP_LT_OQ ); }
+  static inline type select( const type a, const type b, const type m ) { return _mm256_blendv_ps( a, b, m ); } // m ? b : a
+};
+#endif
+
+
+
+//
+// double pack operations for the kernels in double precision, the scalar pack does the
+// remainder of a batch, as all operations are exactly rounded every lane gives the same result
+//
+struct scalarPackd
+{
+  typedef double type;
+  static const int size = 1;
+  static inline type set1(  const double a )              { return a; }
+  static inline type load(  const double *a )             { return *a; }
+  static inline void store( double *a, const type b )     { *a = b; }
+  static inline type add(   const type a, const type b )  { return a + b; }
+  static inline type sub(   const type a, const type b )  { return a - b; }
+  static inline type mul(   const type a, const type b )  { return a * b; }
+  static inline type div(   const type a, const type b )  { return a / b; }
+  static inline type sqrt(  const type a )                { return std::sqrt( a ); }
+};
+
+
+
+#ifdef __SSE2__
+//
+// double pack operations for SSE2
+//
+struct ssePackd
+{
+  typedef __m128d type;
+  static const int size = 2;
+  static inline type set1(  const double a )              { return _mm_set1_pd( a ); }
+  static inline type load(  const double *a )             { return _mm_loadu_pd( a ); }
+  static inline void store( double *a, const type b )     { _mm_storeu_pd( a, b ); }
+  static inline type add(   const type a, const type b )  { return _mm_add_pd( a, b ); }
+  static inline type sub(   const type a, const type b )  { return _mm_sub_pd( a, b ); }
+  static inline type mul(   const type a, const type b )  { return _mm_mul_pd( a, b ); }
+  static inline type div(   const type a, const type b )  { return _mm_div_pd( a, b ); }
+  static inline type sqrt(  const type a )                { return _mm_sqrt_pd( a ); }
+};
+#endif
+
+
+
+#ifdef __AVX2__
+//
+// double pack operations for AVX2
+//
+struct avxPackd
+{
+  typedef __m256d type;
+  static const int size = 4;
+  static inline type set1(  const double a )              { return _mm256_set1_pd( a ); }
+  static inline type load(  const double *a )             { return _mm256_loadu_pd( a ); }
+  static inline void store( double *a, const type b )     { _mm256_storeu_pd( a, b ); }
+  static inline type add(   const type a, const type b )  { return _mm256_add_pd( a, b ); }
+  static inline type sub(   const type a, const type b )  { return _mm256_sub_pd( a, b ); }
+  static inline type mul(   const type a, const type b )  { return _mm256_mul_pd( a, b ); }
+  static inline type div(   const type a, const type b )  { return _mm256_div_pd( a, b ); }
+  static inline type sqrt(  const type a )                { return _mm256_sqrt_pd( a ); }
+};
+#endif
+
+
+
+//
+// sine and cosine of a pack of floats, using the Cephes single precision polynomials
+// the argument is reduced to [-pi/4,pi/4] with the quadrant q = round(|x|*2/pi) and the
+// quadrant decides about swapping the polynomials and the signs, accurate for |x| < 8192
+//
+template<typename P>
+inline void sincosPack( const typename P::type ax, typename P::type &as, typename P::type &ac )
+{
+   typedef typename P::type type;
+   const type signmask = P::set1( -0.0f );
+   const type one      = P::set1( 1.0f );
+   const type two      = P::set1( 2.0f );
+   const type four     = P::set1( 4.0f );
+   const type half     = P::set1( 0.5f );
+
+   // absolute value and sign of the argument
+   type x    = P::andnot( signmask, ax );
+   type sign = P::and_( signmask, ax );
+
+   // quadrant, the multiples of pi/2 are subtracted in three parts for extra precision
+   type q = P::floor( P::add( P::mul( x, P::set1( 0.63661977236758134308f ) ), half ) );
+   x = P::sub( x, P::mul( q, P::set1( 1.5703125f ) ) );
+   x = P::sub( x, P::mul( q, P::set1( 4.837512969970703125e-4f ) ) );
+   x = P::sub( x, P::mul( q, P::set1( 7.54978995489188216e-8f ) ) );
+
+   // polynomials for sine and cosine on [-pi/4,pi/4]
+   type z  = P::mul( x, x );
+   type ys = P::set1( -1.9515295891e-4f );
+   ys = P::add( P::mul( ys, z ), P::set1( 8.3321608736e-3f ) );
+   ys = P::add( P::mul( ys, z ), P::set1( -1.6666654611e-1f ) );
+   ys = P::add( P::mul( P::mul( ys, z ), x ), x );
+   type yc = P::set1( 2.443315711809948e-5f );
+   yc = P::add( P::mul( yc, z ), P::set1( -1.388731625493765e-3f ) );
+   yc = P::add( P::mul( yc, z ), P::set1( 4.166664568298827e-2f ) );
+   yc = P::add( P::sub( P::mul( P::mul( yc, z ), z ), P::mul( half, z ) ), one );
+
+   // q modulo 4 selects the polynomial and the signs
+   type m    = P::sub( q, P::mul( four, P::floor( P::mul( q, P::set1( 0.25f ) ) ) ) );
+   type odd  = P::eq( P::sub( m, P::mul( two, P::floor( P::mul( m, half ) ) ) ), one );
+   type sneg = P::and_( signmask, P::lt( P::set1( 1.5f ), m ) );                                              // q = 2,3
+   type cneg = P::and_( signmask, P::and_( P::lt( half, m ), P::lt( m, P::set1( 2.5f ) ) ) );                 // q = 1,2
+   as = P::xor_( P::xor_( P::select( ys, yc, odd ), sneg ), sign );
+   ac = P::xor_( P::select( yc, ys, odd ), cneg );
+}
+
+
+
+//
+// exponential map of SO(3) for a pack of angles about one axis, the axis and a*a' are
+// given as broadcast packs, the rows of the resulting rotations are returned as nine packs aR[3*row+col]
+// as so3Exp, angles with a square below the smallest normal number give the exact identity
+//
+template<typename P>
+inline void so3ExpPack( const typename P::type *aaxis, const typename P::type *aaT, const typename P::type aangle, typename P::type *aR )
+{
+   typedef typename P::type type;
+   type s, c;
+   sincosPack<P>( aangle, s, c );
+
+   // identity for tiny angles
+   type tiny = P::lt( P::mul( s, s ), P::set1( std::numeric_limits<float>::min() ) );
+   s = P::andnot( tiny, s );
+   c = P::select( c, P::set1( 1.0f ), tiny );
+
+   // Rodrigues' formula
+   type omc = P::sub( P::set1( 1.0f ), c );
+   for( int k = 0; k < 9; k++ )
+     aR[k] = P::mul( aaT[k], omc );
+   aR[0] = P::add( aR[0], c );
+   aR[4] = P::add( aR[4], c );
+   aR[8] = P::add( aR[8], c );
+   aR[1] = P::sub( aR[1], P::mul( s, aaxis[2] ) );
+   aR[3] = P::add( aR[3], P::mul( s, aaxis[2] ) );
+   aR[2] = P::add( aR[2], P::mul( s, aaxis[1] ) );
+   aR[6] = P::sub( aR[6], P::mul( s, aaxis[1] ) );
+   aR[5] = P::sub( aR[5], P::mul( s, aaxis[0] ) );
+   aR[7] = P::add( aR[7], P::mul( s, aaxis[0] ) );
+}
+
+
+
+//
+// rotations of the interpolated rotation steps exp(axis, angle*aweights[i]/anormalizer)
+// for acount poses, written to the rotation part of aupd[0..acount-1], e.g. a tile of a sweep
+//
+template<typename Storage, typename Accum>
+inline void so3ExpSteps( const Eigen::Matrix<Accum,3,1> &aaxis, const Eigen::Matrix<Accum,3,3> &aaT, const Accum aangle, const Accum *aweights, const Accum anormalizer, se3PoseT<Storage> *aupd, const int acount )
+{
+   Eigen::Matrix<Accum,3,3> R;
+   Accum                    theta;
+   for( int i = 0; i < acount; i++ )
+   {
+      theta = aangle*(aweights[i]/anormalizer);
+      so3Exp( aaxis, aaT, Accum(std::cos(theta)), Accum(std::sin(theta)), R );
+      aupd[i].R = R.template cast<Storage>();
+   }
+}
+
+
+
+#ifdef __SSE4_1__
+//
+// write the nine row packs of P::size rotations to consecutive poses
+//
+template<typename Storage, typename P>
+inline void storeRotations( const typename P::type *aR, se3PoseT<Storage> *aupd )
+{
+   float out[9][P::size];
+   for( int k = 0; k < 9; k++ )
+     P::store( out[k], aR[k] );
+   for( int l = 0; l < P::size; l++ )
+   {
+     Eigen::Matrix<Storage,3,3> &Rl = aupd[l].R;
+     Rl(0,0) = out[0][l]; Rl(0,1) = out[1][l]; Rl(0,2) = out[2][l];
+     Rl(1,0) = out[3][l]; Rl(1,1) = out[4][l]; Rl(1,2) = out[5][l];
+     Rl(2,0) = out[6][l]; Rl(2,1) = out[7][l]; Rl(2,2) = out[8][l];
+   }
+}
+
+
+
+//
+// single precision poses are stored with 4x4 transposes, the nine column-major rotation
+// elements of a pose are contiguous, i.e. two unaligned stores and one scalar store per pose
+//
+template<>
+inline void storeRotations<float,ssePack>( const __m128 *aR, se3PoseT<float> *aupd )
+{
+   // column-major order is R00 R10 R20 R01 | R11 R21 R02 R12 | R22
+   __m128 a = aR[0], b = aR[3], c = aR[6], d = aR[1];
+   __m128 e = aR[4], f = aR[7], g = aR[2], h = aR[5];
+   _MM_TRANSPOSE4_PS( a, b, c, d );
+   _MM_TRANSPOSE4_PS( e, f, g, h );
+   float last[4];
+   _mm_storeu_ps( last, aR[8] );
+   _mm_storeu_ps( aupd[0].R.data(), a ); _mm_storeu_ps( aupd[0].R.data()+4, e ); aupd[0].R(2,2) = last[0];
+   _mm_storeu_ps( aupd[1].R.data(), b ); _mm_storeu_ps( aupd[1].R.data()+4, f ); aupd[1].R(2,2) = last[1];
+   _mm_storeu_ps( aupd[2].R.data(), c ); _mm_storeu_ps( aupd[2].R.data()+4, g ); aupd[2].R(2,2) = last[2];
+   _mm_storeu_ps( aupd[3].R.data(), d ); _mm_storeu_ps( aupd[3].R.data()+4, h ); aupd[3].R(2,2) = last[3];
+}
+
+
+
+//
+// batched version of the rotation steps for single precision accumulation
+//
+template<typename P, typename Storage>
+inline int so3ExpStepsPack( const float *aaxis, const float *aaT, const float aangle, const float *aweights, const float anormalizer, se3PoseT<Storage> *aupd, const int acount )
+{
+   typedef typename P::type type;
+   type    R[9];
+   type    axis[3];
+   type    aT[9];
+   type    angle      = P::set1( aangle );
+   type    normalizer = P::set1( anormalizer );
+   int     i          = 0;
+
+   // broadcast the axis and a*a' once, the stores to the poses could alias them otherwise
+   for( int k = 0; k < 3; k++ )
+     axis[k] = P::set1( aaxis[k] );
+   for( int k = 0; k < 9; k++ )
+     aT[k] = P::set1( aaT[k] );
+
+   for( ; i+P::size <= acount; i += P::size )
+   {
+      // angles and rotations of P::size poses
+      so3ExpPack<P>( axis, aT, P::mul( angle, P::div( P::load( aweights+i ), normalizer ) ), R );
+      storeRotations<Storage,P>( R, aupd+i );
+   }
+   return i;
+}
+
+
+
+template<typename Storage>
+inline void so3ExpSteps( const Eigen::Matrix<float,3,1> &aaxis, const Eigen::Matrix<float,3,3> &aaT, const float aangle, const float *aweights, const float anormalizer, se3PoseT<Storage> *aupd, const int acount )
+{
+   // axis and a*a' in row-major order
+   float axis[3] = { aaxis(0), aaxis(1), aaxis(2) };
+   float aT[9]   = { aaT(0,0), aaT(0,1), aaT(0,2), aaT(1,0), aaT(1,1), aaT(1,2), aaT(2,0), aaT(2,1), aaT(2,2) };
+
+   // full packs, the remainder is done one pose at a time
+   int done = 0;
+#ifdef __AVX2__
+   done += so3ExpStepsPack<avxPack>( axis, aT, aangle, aweights+done, anormalizer, aupd+done, acount-done );
+#endif
+   done += so3ExpStepsPack<ssePack>( axis, aT, aangle, aweights+done, anormalizer, aupd+done, acount-done );
+   so3ExpSteps<Storage,float>( aaxis, aaT, aangle, aweights+done, anormalizer, aupd+done, acount-done );
+}
+#endif
+
+
+
+//
+// mean translation and rotation variance of a pack of symmetric positive definite 6x6 information
+// matrices, given by their 21 upper triangular entries packed row by row, i.e. a[6*i - i*(i-1)/2 + j-i]
+// holds A(i,j) for i <= j, only the diagonal of the inverse is computed, from the factorization A = L*D*L'
+// as inv(A) = X'*inv(D)*X with X = inv(L), i.e. inv(A)(i,i) = 1/D(i) + sum_k>i X(k,i)^2/D(k)
+//
+template<typename P>
+inline void infoWeightsPack( const typename P::type *aa, typename P::type &atra, typename P::type &arot )
+{
+   typedef typename P::type type;
+   type L[6][6]; // unit lower triangular factor, below the diagonal
+   type W[6][6]; // L(i,j)*D(j)
+   type D[6];    // diagonal factor
+   type X[6][6]; // inverse of L, below the diagonal
+
+   // factorization, row j of the packed values starts at rj
+   for( int j = 0, rj = 0; j < 6; rj += 6-j, j++ )
+   {
+      type d = aa[rj];
+      for( int k = 0; k < j; k++ )
+	d = P::sub( d, P::mul( W[j][k], L[j][k] ) );
+      D[j] = d;
+      for( int i = j+1; i < 6; i++ )
+      {
+	 type w = aa[rj + i-j];
+	 for( int k = 0; k < j; k++ )
+	   w = P::sub( w, P::mul( L[i][k], W[j][k] ) );
+	 W[i][j] = w;
+	 L[i][j] = P::div( w, d );
+      }
+   }
+
+   // inverse of L by forward substitution
+   for( int j = 0; j < 6; j++ )
+     for( int i = j+1; i < 6; i++ )
+     {
+	type x = L[i][j];
+	for( int k = j+1; k < i; k++ )
+	  x = P::add( x, P::mul( L[i][k], X[k][j] ) );
+	X[i][j] = P::sub( P::set1( 0.0 ), x );
+     }
+
+   // standard deviations and their squared means
+   type s[6];
+   for( int i = 0; i < 6; i++ )
+   {
+      type v = P::div( P::set1( 1.0 ), D[i] );
+      for( int k = i+1; k < 6; k++ )
+	v = P::add( v, P::div( P::mul( X[k][i], X[k][i] ), D[k] ) );
+      s[i] = P::sqrt( v );
+   }
+   type t = P::div( P::add( P::add( s[0], s[1] ), s[2] ), P::set1( 3.0 ) );
+   type r = P::div( P::add( P::add( s[3], s[4] ), s[5] ), P::set1( 3.0 ) );
+   atra = P::mul( t, t );
+   arot = P::mul( r, r );
+}
+
+
+
+//
+// weights of the full packs of a batch, returns the number of matrices done
+// the values of matrix k start at ainfo, its weights are stored at atra and arot, all advanced by k*astride bytes
+//
+template<typename P>
+inline size_t infoWeightsBatch( const size_t an, const size_t astride, const float *ainfo, double *atra, double *arot )
+{
+   typedef typename P::type type;
+   double values[21][P::size];
+   double tra[P::size], rot[P::size];
+   type   a[21], t, r;
+   size_t n = 0;
+   for( ; n+P::size <= an; n += P::size )
+   {
+      // transpose the values of the matrices into the lanes
+      for( int l = 0; l < P::size; l++ )
+      {
+	 const float *info = (const float*)((const char*)ainfo + (n+l)*astride);
+	 for( int k = 0; k < 21; k++ )
+	   values[k][l] = info[k];
+      }
+      for( int k = 0; k < 21; k++ )
+	a[k] = P::load( values[k] );
+      infoWeightsPack<P>( a, t, r );
+      P::store( tra, t );
+      P::store( rot, r );
+      for( int l = 0; l < P::size; l++ )
+      {
+	 *(double*)((char*)atra + (n+l)*astride) = tra[l];
+	 *(double*)((char*)arot + (n+l)*astride) = rot[l];
+      }
+   }
+   return n;
+}
+
+
+
+//
+// weights of a batch of packed information matrices, in packs of the widest instruction set
+// a matrix gets the same weights whether it is done alone or as part of a batch
+//
+inline void packedWeights( const size_t an, const size_t astride, const float *ainfo, double *atra, double *arot )
+{
+   size_t done = 0;
+#ifdef __AVX2__
+   done += infoWeightsBatch<avxPackd>( an-done, astride, (const float*)((const char*)ainfo + done*astride), (double*)((char*)atra + done*astride), (double*)((char*)arot + done*astride) );
+#endif
+#ifdef __SSE2__
+   done += infoWeightsBatch<ssePackd>( an-done, astride, (const float*)((const char*)ainfo + done*astride), (double*)((char*)atra + done*astride), (double*)((char*)arot + done*astride) );
+#endif
+   infoWeightsBatch<scalarPackd>( an-done, astride, (const float*)((const char*)ainfo + done*astride), (double*)((char*)atra + done*astride), (double*)((char*)arot + done*astride) );
+}
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+
+
+using namespace std;
+
+
+
+//
+// fixed-size pool of worker threads that runs a batch of numbered tasks
+// the calling thread takes part in the batch, such that a pool of size one has no workers
+// and runs all tasks on the calling thread
+//
+class threadPool {
+  
+  public:
+    
+    threadPool( const int anthreads = 0 ); // constructor, zero threads means one per hardware thread
+    ~threadPool();                         // destructor, joins the workers
+    
+    int  size(   void ) const;             // the number of threads, including the calling thread
+    void resize( const int anthreads );    // change the number of threads, zero means one per hardware thread
+    
+    // run atask(k) for k = 0..antasks-1 and return when all tasks are done
+    // the task is called through a pointer to it, such that a batch does not allocate
+    template<typename Task>
+    void run( const int antasks, const Task &atask )
+    {
+      runTasks( antasks, &atask, &callTask<Task> );
+    }
+    
+  private:
+    
+    // call task atask of type Task with ak
+    template<typename Task>
+    static void callTask( const void *atask, const int ak )
+    {
+      (*(const Task*)atask)( ak );
+    }
+    
+    void runTasks( const int antasks, const void *atask, void (*acall)( const void*, const int ) ); // run a batch
+    void start(  const int anthreads ); // create the workers
+    void stop(   void );                // join the workers
+    void worker( void );                // the loop of a worker thread
+    void work(   void );                // take tasks of the current batch until there are none left
+    
+    // the workers
+    vector<thread> workers;
+    
+    // the current batch
+    const void   *task;
+    void        (*call)( const void*, const int );
+    int           ntasks;
+    atomic<int>   next;
+    int           busy;
+    unsigned long batch;
+    bool          quit;
+    
+    // synchronization between the calling thread and the workers
+    mutex              lock;
+    condition_variable wakeup;
+    condition_variable finished;
+};
+
+#endif
@@ -0,0 +1,249 @@
+#ifndef WEIGHTTREE_HPP
+#define WEIGHTTREE_HPP
+
+#include "chainStore.hpp"
+
+
+
+//
+// vector of information weights stored as a segment tree over a power of two number of leaves
+// range sums and range multiplications cost O(log n), such that the bookkeeping of a loop closure
+// does not depend on the length of the loop
+// node (h,lo) at level h covers the leaves lo upto lo+2^h, its children are (h-1,lo) and (h-1,lo+2^(h-1)),
+// the leaves are the nodes at level 0 and the root is (levels,0)
+// sum    = sum of the weights below a node, including the factors of the node and below
+// factor = pending factor of the children of a node, i.e. a lazy multiplication
+// the nodes are appended with their first leaf, such that the tree grows without moving or rebuilding,
+// the nodes of which the first leaf does not exist yet are not used and count as zero
+// the indices are 64-bit, the number of nodes exceeds the range of an int for chains of over 2^30 poses
+//
+template<typename T>
+class weightTree {
+
+  public:
+
+    weightTree( void )
+    {
+      clear();
+    }
+
+    // remove all weights
+    void clear( void )
+    {
+      n      = 0;
+      levels = 0;
+      weights.clear();
+      inner.clear();
+    }
+
+    // the number of weights
+    long size( void ) const
+    {
+      return n;
+    }
+
+    // change the number of weights, the existing weights are kept and new weights are zero
+    // growing appends the leaves and the nodes that start at them, the number of leaves doubles by adding a root
+    // above the old one, such that it costs O(log n) per weight at most, shrinking rebuilds the internal nodes
+    void resize( const long an )
+    {
+      if( an < n )
+      {
+	flush( 0, n-1 );
+	n      = an;
+	levels = 0;
+	while( (1L << levels) < n )
+	  levels++;
+	weights.resize( n, T(0) );
+	inner.resize( (1 < n) ? (n-1)-__builtin_popcountl( n-1 ) : 0, node() );
+	for( long h = 1; h <= levels; h++ )
+	  for( long lo = 0; lo < n; lo += 1L << h )
+	  {
+	    at( h, lo ).sum    = childSum( h-1, lo ) + childSum( h-1, lo+(1L << (h-1)) );
+	    at( h, lo ).factor = T(1);
+	  }
+	return;
+      }
+      for( ; n < an; n++ )
+      {
+	if( (0 < n) && (n == (1L << levels)) )
+	{
+	  top[levels+1].sum    = childSum( levels, 0 );
+	  top[levels+1].factor = T(1);
+	  levels++;
+	}
+	weights.push_back( T(0) );
+	for( long h = 1; (0 < n) && (0 == (n & ((1L << h)-1))); h++ )
+	  inner.push_back( node() );
+      }
+    }
+
+    // make sure an weights can be stored without adding segments to the stores
+    void reserve( const long an )
+    {
+      weights.reserve( an );
+      inner.reserve( (1 < an) ? (an-1)-__builtin_popcountl( an-1 ) : 0 );
+    }
+
+    // the allocator of the stores of the tree
+    void setAllocator( chainAllocator &aallocator )
+    {
+      weights.setAllocator( aallocator );
+      inner.setAllocator( aallocator );
+    }
+
+    // set weight ai
+    void set( const long ai, const T av )
+    {
+      flush( ai, ai );
+      weights[ai] = av;
+      for( long h = 1; h <= levels; h++ )
+      {
+	long  lo = (ai >> h) << h;
+	node &k  = at( h, lo );
+	k.sum    = (childSum( h-1, lo ) + childSum( h-1, lo+(1L << (h-1)) ))*k.factor;
+      }
+    }
+
+    // weight ai, i.e. the leaf with the pending factors of its ancestors
+    T get( const long ai ) const
+    {
+      T value = weights[ai];
+      for( long h = 1; h <= levels; h++ )
+	value *= at( h, (ai >> h) << h ).factor;
+      return value;
+    }
+
+    // sum of the weights afirst upto alast, zero for an empty range
+    T sum( const long afirst, const long alast ) const
+    {
+      if( alast < afirst )
+	return T(0);
+      return sumNode( levels, 0, afirst, alast );
+    }
+
+    // multiply the weights afirst upto alast with afactor
+    void multiply( const long afirst, const long alast, const T afactor )
+    {
+      if( afirst <= alast )
+	multiplyNode( levels, 0, afirst, alast, afactor );
+    }
+
+    // apply the pending factors to the weights afirst upto alast, i.e. make their leaves exact
+    void flush( const long afirst, const long alast )
+    {
+      if( afirst <= alast )
+	flushNode( levels, 0, afirst, alast );
+    }
+
+    // contiguous leaves, leaves()[i] is weight i when it has been flushed since the last multiplication
+    // the address of the leaves does not change when the tree grows
+    const T *leaves( void ) const
+    {
+      return &weights[0];
+    }
+
+  private:
+
+    // an internal node
+    struct node {
+      T sum;
+      T factor;
+      node( void ) : sum(0), factor(1) {}
+    };
+
+    // no copies of the stores
+    weightTree( const weightTree & );
+    weightTree &operator=( const weightTree & );
+
+    long             n;       // number of weights
+    long             levels;  // number of levels above the leaves, the number of leaves is 2^levels
+    chainStore<T>    weights; // the leaves
+    chainStore<node> inner;   // the internal nodes with a first leaf lo > 0, ordered by lo and level
+    node             top[64]; // the internal nodes with first leaf 0, by level
+
+    // internal node (ah,alo), the nodes with a first leaf upto alo number (alo-1)-popcount(alo-1)
+    node &at( const long ah, const long alo )
+    {
+      return (0 == alo) ? top[ah] : inner[(alo-1) - __builtin_popcountl( alo-1 ) + ah-1];
+    }
+
+    const node &at( const long ah, const long alo ) const
+    {
+      return (0 == alo) ? top[ah] : inner[(alo-1) - __builtin_popcountl( alo-1 ) + ah-1];
+    }
+
+    // the sum of node (ah,alo), zero when its first leaf does not exist
+    T childSum( const long ah, const long alo ) const
+    {
+      if( n <= alo )
+	return T(0);
+      return (0 == ah) ? weights[alo] : at( ah, alo ).sum;
+    }
+
+    // multiply the sum of node (ah,alo) and the pending factor of its children with afactor
+    void scale( const long ah, const long alo, const T afactor )
+    {
+      if( n <= alo )
+	return;
+      if( 0 == ah )
+	weights[alo] *= afactor;
+      else
+      {
+	at( ah, alo ).sum    *= afactor;
+	at( ah, alo ).factor *= afactor;
+      }
+    }
+
+    T sumNode( const long ah, const long alo, const long afirst, const long alast ) const
+    {
+      if( 0 == ah )
+	return weights[alo];
+      const node &k = at( ah, alo );
+      if( (afirst <= alo) && (alo+(1L << ah)-1 <= alast) )
+	return k.sum;
+      long mid   = alo + (1L << (ah-1));
+      T    value = T(0);
+      if( afirst < mid )
+	value += sumNode( ah-1, alo, afirst, alast );
+      if( mid <= alast )
+	value += sumNode( ah-1, mid, afirst, alast );
+      return value*k.factor;
+    }
+
+    void multiplyNode( const long ah, const long alo, const long afirst, const long alast, const T afactor )
+    {
+      if( (afirst <= alo) && (alo+(1L << ah)-1 <= alast) )
+      {
+	scale( ah, alo, afactor );
+	return;
+      }
+      long mid = alo + (1L << (ah-1));
+      if( afirst < mid )
+	multiplyNode( ah-1, alo, afirst, alast, afactor );
+      if( mid <= alast )
+	multiplyNode( ah-1, mid, afirst, alast, afactor );
+      node &k = at( ah, alo );
+      k.sum   = (childSum( ah-1, alo ) + childSum( ah-1, mid ))*k.factor;
+    }
+
+    void flushNode( const long ah, const long alo, const long afirst, const long alast )
+    {
+      if( 0 == ah )
+	return;
+      node &k   = at( ah, alo );
+      long  mid = alo + (1L << (ah-1));
+      if( k.factor != T(1) )
+      {
+	scale( ah-1, alo, k.factor );
+	scale( ah-1, mid, k.factor );
+	k.factor = T(1);
+      }
+      if( afirst < mid )
+	flushNode( ah-1, alo, afirst, alast );
+      if( mid <= alast )
+	flushNode( ah-1, mid, afirst, alast );
+    }
+};
+
+#endif
@@ -0,0 +1,233 @@
+
+
+
+
+#include <cstdlib>
+#include <new>
+#include <atomic>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "chainAllocator.hpp"
+#include "chainStore.hpp"
+
+
+
+//
+// the allocator of the stores that are not given one
+//
+chainAllocator &chainAllocator::standard( void )
+{
+  static mmapAllocator allocator;
+  return allocator;
+}
+
+
+
+//
+// make the reserved address space usable, the kernel provides the pages when they are first used
+//
+bool mmapAllocator::commit( char *aaddress, const size_t abytes )
+{
+  return 0 == mprotect( aaddress, abytes, PROT_READ | PROT_WRITE );
+}
+
+
+
+//
+// make the reserved address space usable and ask for huge pages, the segments of a store are aligned to them
+//
+bool hugepageAllocator::commit( char *aaddress, const size_t abytes )
+{
+  if( 0 != mprotect( aaddress, abytes, PROT_READ | PROT_WRITE ) )
+    return false;
+  madvise( aaddress, abytes, MADV_HUGEPAGE );
+  return true;
+}
+
+
+
+//
+// constructor
+//
+arenaAllocator::arenaAllocator( const size_t abytes, const bool alock )
+{
+  length = ((abytes+CHAIN_SEGMENT-1)/CHAIN_SEGMENT)*CHAIN_SEGMENT;
+  arena  = (char*)mmap( NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0 );
+  mapped = (arena != (char*)MAP_FAILED);
+  if( !mapped )
+  {
+    arena  = NULL;
+    length = 0;
+  }
+  else if( alock )
+    mapped = (0 == mlock( arena, length ));
+}
+
+
+
+//
+// destructor
+//
+arenaAllocator::~arenaAllocator()
+{
+  if( 0 < length )
+    munmap( arena, length );
+}
+
+
+
+//
+// move the next pages of the arena to the reserved address space, or make it usable when the arena is used up
+//
+bool arenaAllocator::commit( char *aaddress, const size_t abytes )
+{
+  if( length < abytes )
+    return 0 == mprotect( aaddress, abytes, PROT_READ | PROT_WRITE );
+  if( MAP_FAILED == mremap( arena, abytes, abytes, MREMAP_MAYMOVE | MREMAP_FIXED, aaddress ) )
+    return false;
+  arena  += abytes;
+  length -= abytes;
+  return true;
+}
+
+
+
+//
+// could the arena be mapped, and locked when requested
+//
+bool arenaAllocator::good( void ) const
+{
+  return mapped;
+}
+
+
+
+//
+// the number of bytes not handed out yet
+//
+size_t arenaAllocator::available( void ) const
+{
+  return length;
+}
+
+
+
+#ifdef ALLOCATION_CHECK
+
+// the number of active checks, the allocations of all threads are checked
+static atomic<int> activeChecks( 0 );
+
+// the allocation functions of the C library, the calls of the program go to the wrappers below (see CMakeLists.txt)
+extern "C" void *__real_malloc( size_t abytes );
+extern "C" void *__real_calloc( size_t an, size_t abytes );
+extern "C" void *__real_realloc( void *apointer, size_t abytes );
+extern "C" int   __real_posix_memalign( void **apointer, size_t aalignment, size_t abytes );
+
+
+
+//
+// abort when a check is active, the message is written without allocating
+//
+static void checkAllocation( void )
+{
+  if( 0 < activeChecks )
+  {
+    activeChecks = 0;
+    const char message[] = "Heap allocation in the steady state of the pose chain\n";
+    if( write( 2, message, sizeof(message)-1 ) ) {}
+    abort();
+  }
+}
+
+
+
+//
+// the checked allocation functions
+//
+extern "C" void *__wrap_malloc( size_t abytes )
+{
+  checkAllocation();
+  return __real_malloc( abytes );
+}
+
+extern "C" void *__wrap_calloc( size_t an, size_t abytes )
+{
+  checkAllocation();
+  return __real_calloc( an, abytes );
+}
+
+extern "C" void *__wrap_realloc( void *apointer, size_t abytes )
+{
+  checkAllocation();
+  return __real_realloc( apointer, abytes );
+}
+
+extern "C" int __wrap_posix_memalign( void **apointer, size_t aalignment, size_t abytes )
+{
+  checkAllocation();
+  return __real_posix_memalign( apointer, aalignment, abytes );
+}
+
+void *operator new( size_t abytes )
+{
+  checkAllocation();
+  void *pointer = __real_malloc( abytes ? abytes : 1 );
+  if( pointer == NULL )
+    throw bad_alloc();
+  return pointer;
+}
+
+void *operator new[]( size_t abytes )
+{
+  return operator new( abytes );
+}
+
+void *operator new( size_t abytes, const nothrow_t & ) throw()
+{
+  checkAllocation();
+  return __real_malloc( abytes ? abytes : 1 );
+}
+
+void *operator new[]( size_t abytes, const nothrow_t & ) throw()
+{
+  return operator new( abytes, nothrow );
+}
+
+void operator delete( void *apointer ) throw()
+{
+  free( apointer );
+}
+
+void operator delete[]( void *apointer ) throw()
+{
+  free( apointer );
+}
+
+#endif
+
+
+
+//
+// start a check when aactive is true
+//
+allocationCheck::allocationCheck( const bool aactive )
+{
+  active = aactive;
+#ifdef ALLOCATION_CHECK
+  if( active )
+    activeChecks++;
+#endif
+}
+
+
+
+//
+// end the check
+//
+allocationCheck::~allocationCheck()
+{
+#ifdef ALLOCATION_CHECK
+  if( active )
+    activeChecks--;
+#endif
+}
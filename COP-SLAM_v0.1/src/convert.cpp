@@ -0,0 +1,168 @@
+
+
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include "poseChain.hpp"
+#include "mappedFile.hpp"
+#include "graphFile.hpp"
+
+
+
+using namespace std;
+
+
+
+//
+// convert a g2o file to a binary graph
+// the solution space follows from the vertices like in the parser of COP-SLAM
+//
+bool g2oToBinary( const mappedFile &aInput, const string &aOutput )
+{
+   vector<vertexRecord>     vertices;
+   vector<edgeRecord>       edges;
+   vertexRecord             vertex;
+   edgeRecord               edge;
+   int                      nse3  = 0;
+   int                      nsim3 = 0;
+   string                   lastLine;
+   const char              *begin = aInput.data();
+   const char              *last  = aInput.data() + aInput.size();
+   while( begin < last )
+   {
+      // the next line (last line may not end with \n, it is copied such that it ends with \0)
+      const char *end = (const char*)memchr( begin, '\n', last-begin );
+      if( end == NULL )
+      {
+	lastLine.assign( begin, last );
+	begin = lastLine.c_str();
+	last  = begin + lastLine.size();
+	end   = last;
+      }
+      const char *line = begin;
+      begin = end+1;
+
+      // vertices and edges with their weights
+      int  type = graphLine( line, end-line );
+      bool ok   = true;
+      if( (LINE_VERTEX_SE3 == type) || (LINE_VERTEX_RST3 == type) || (LINE_VERTEX_RT3 == type) )
+      {
+	 nse3  += (LINE_VERTEX_SE3  == type);
+	 nsim3 += (LINE_VERTEX_RST3 == type);
+	 ok     = scanVertex( line, end, vertex );
+	 vertices.push_back( vertex );
+      }
+      else if( (LINE_EDGE_SE3 == type) || (LINE_EDGE_RST3 == type) || (LINE_EDGE_RT3 == type) )
+      {
+	 ok = scanEdge( line, end, edge );
+	 edges.push_back( edge );
+      }
+      if( !ok )
+      {
+	 cerr << "Unable to parse: " << string( line, end-line ) << endl;
+	 return false;
+      }
+   }
+
+   // the weights of the edges in batches
+   if( !edges.empty() )
+     poseChain<double,double>::infoWeights( edges.size(), sizeof(edgeRecord), edges[0].info, &edges[0].tra, &edges[0].rot );
+
+   // write the records
+   int space = (0 < nse3) ? SPACE_SE3 : ((0 < nsim3) ? SPACE_SIM3 : SPACE_RT3);
+   if( !binaryGraph::write( aOutput, space, vertices, edges ) )
+   {
+      cerr << "Unable to create output file: " << aOutput << endl;
+      return false;
+   }
+   cout << "Converted " << vertices.size() << " vertices and " << edges.size() << " edges to a binary graph" << endl;
+   return true;
+}
+
+
+
+//
+// convert a binary graph to a g2o file
+// the numbers are written with 9 significant digits, such that they are parsed into the same floats
+//
+bool binaryToG2o( const mappedFile &aInput, const string &aOutput )
+{
+   binaryGraph graph( aInput.data(), aInput.size() );
+   if( !graph.good() )
+   {
+      cerr << "Unsupported binary graph file" << endl;
+      return false;
+   }
+   FILE *file = fopen( aOutput.c_str(), "w" );
+   if( file == NULL )
+   {
+      cerr << "Unable to create output file: " << aOutput << endl;
+      return false;
+   }
+
+   // the tags of the solution space
+   const char *vertexTag = "VERTEX_SE3:QUAT";
+   const char *edgeTag   = "EDGE_SE3:QUAT";
+   if( SPACE_SIM3 == graph.space() )
+   {
+      vertexTag = "VERTEX_RST3:QUAT";
+      edgeTag   = "EDGE_RST3:QUAT";
+   }
+   else if( SPACE_RT3 == graph.space() )
+   {
+      vertexTag = "VERTEX_RT3:QUAT";
+      edgeTag   = "EDGE_RT3:QUAT";
+   }
+
+   // vertices and edges
+   for( size_t n = 0; n < graph.nvertices(); n++ )
+   {
+      const vertexRecord &v = graph.vertices()[n];
+      fprintf( file, "%s %d %.9g %.9g %.9g %.9g %.9g %.9g %.9g", vertexTag, (int)n, v.t[0], v.t[1], v.t[2], v.q[0], v.q[1], v.q[2], v.q[3] );
+      if( SPACE_SIM3 == graph.space() )
+	fprintf( file, " %.9g", v.s );
+      fprintf( file, "\n" );
+   }
+   for( size_t n = 0; n < graph.nedges(); n++ )
+   {
+      const edgeRecord &e = graph.edges()[n];
+      fprintf( file, "%s %d %d %.9g %.9g %.9g %.9g %.9g %.9g %.9g", edgeTag, e.start, e.end, e.t[0], e.t[1], e.t[2], e.q[0], e.q[1], e.q[2], e.q[3] );
+      if( SPACE_SIM3 == graph.space() )
+	fprintf( file, " %.9g", e.s );
+      for( int k = 0; k < 21; k++ )
+	fprintf( file, " %.9g", e.info[k] );
+      fprintf( file, "\n" );
+   }
+   if( 0 != fclose( file ) )
+   {
+      cerr << "Unable to write output file: " << aOutput << endl;
+      return false;
+   }
+   cout << "Converted " << graph.nvertices() << " vertices and " << graph.nedges() << " edges to a g2o file" << endl;
+   return true;
+}
+
+
+
+//
+// convert between g2o files and binary graphs, the direction follows from the input
+//
+int main(int argc, char** argv)
+{
+   if( argc < 3 )
+   {
+      cout << endl << "usage: copslamconvert <input-file> <output-file>" << endl;
+      cout << "       a g2o input is converted to a binary graph, a binary graph to a g2o file" << endl << endl;
+      return 0;
+   }
+   mappedFile input( argv[1] );
+   if( !input.good() )
+   {
+      cerr << "Unable to open input file: " << argv[1] << endl;
+      return 1;
+   }
+   if( binaryGraph::isBinary( input.data(), input.size() ) )
+     return binaryToG2o( input, argv[2] ) ? 0 : 1;
+   return g2oToBinary( input, argv[2] ) ? 0 : 1;
+}
@@ -0,0 +1,249 @@
+
+
+
+#include <cstdio>
+#include <cstring>
+#include "graphFile.hpp"
+#include "fieldScanner.hpp"
+
+
+
+//
+// is the host little-endian, binary files are only read and written on little-endian hosts
+//
+static bool littleEndian( void )
+{
+  const uint32_t probe = 1;
+  return 1 == *(const unsigned char*)&probe;
+}
+
+
+
+//
+// the type of a g2o line
+//
+int graphLine( const char *aline, const size_t alength )
+{
+  if( (15 <= alength) && (0 == memcmp( aline, "VERTEX_SE3:QUAT", 15 )) )
+    return LINE_VERTEX_SE3;
+  if( (16 <= alength) && (0 == memcmp( aline, "VERTEX_RST3:QUAT", 16 )) )
+    return LINE_VERTEX_RST3;
+  if( (15 <= alength) && (0 == memcmp( aline, "VERTEX_RT3:QUAT", 15 )) )
+    return LINE_VERTEX_RT3;
+  if( (13 <= alength) && (0 == memcmp( aline, "EDGE_SE3:QUAT", 13 )) )
+    return LINE_EDGE_SE3;
+  if( (14 <= alength) && (0 == memcmp( aline, "EDGE_RST3:QUAT", 14 )) )
+    return LINE_EDGE_RST3;
+  if( (13 <= alength) && (0 == memcmp( aline, "EDGE_RT3:QUAT", 13 )) )
+    return LINE_EDGE_RT3;
+  return LINE_OTHER;
+}
+
+
+
+//
+// the solution space of a line type
+//
+int graphSpace( const int atype )
+{
+  if( (LINE_VERTEX_SE3 == atype) || (LINE_EDGE_SE3 == atype) )
+    return SPACE_SE3;
+  if( (LINE_VERTEX_RST3 == atype) || (LINE_EDGE_RST3 == atype) )
+    return SPACE_SIM3;
+  if( (LINE_VERTEX_RT3 == atype) || (LINE_EDGE_RT3 == atype) )
+    return SPACE_RT3;
+  return 0;
+}
+
+
+
+//
+// scan a vertex line, SIM(3) vertices may have the scale after the quaternion
+//
+bool scanVertex( const char *afirst, const char *alast, vertexRecord &arecord )
+{
+  int         id;
+  const char *next = afirst;
+  bool        sim3 = (LINE_VERTEX_RST3 == graphLine( afirst, alast-afirst ));
+
+  // convert to numeric data, skipping the tag
+  arecord.s = 1.0f;
+  if( !scanSkip( next, alast ) || !scanInt( next, alast, id ) )
+    return false;
+  for( int i = 0; i < 3; i++ )
+    if( !scanFloat( next, alast, arecord.t[i] ) )
+      return false;
+  for( int i = 0; i < 4; i++ )
+    if( !scanFloat( next, alast, arecord.q[i] ) )
+      return false;
+  if( sim3 && scanSpace( next, alast ) )
+    return scanFloat( next, alast, arecord.s );
+  return true;
+}
+
+
+
+//
+// scan an edge line, SIM(3) edges have the scale after the quaternion
+//
+bool scanEdge( const char *afirst, const char *alast, edgeRecord &arecord )
+{
+  const char *next = afirst;
+  bool        sim3 = (LINE_EDGE_RST3 == graphLine( afirst, alast-afirst ));
+
+  // convert to numeric data, skipping the tag
+  arecord.s   = 1.0f;
+  arecord.tra = 0.0;
+  arecord.rot = 0.0;
+  arecord.pad = 0.0f;
+  if( !scanSkip( next, alast ) || !scanInt( next, alast, arecord.start ) || !scanInt( next, alast, arecord.end ) )
+    return false;
+  for( int i = 0; i < 3; i++ )
+    if( !scanFloat( next, alast, arecord.t[i] ) )
+      return false;
+  for( int i = 0; i < 4; i++ )
+    if( !scanFloat( next, alast, arecord.q[i] ) )
+      return false;
+  if( sim3 && !scanFloat( next, alast, arecord.s ) )
+    return false;
+  for( int k = 0; k < 21; k++ )
+    if( !scanFloat( next, alast, arecord.info[k] ) )
+      return false;
+  return true;
+}
+
+
+
+//
+// constructor
+//
+binaryGraph::binaryGraph( const char *adata, const size_t asize )
+{
+  header = 0;
+  data   = adata;
+
+  // check the magic, the version and the layout of the records
+  if( !littleEndian() || !isBinary( adata, asize ) || (asize < sizeof(binaryHeader)) )
+    return;
+  const binaryHeader *h = (const binaryHeader*)adata;
+  if( (BINARY_VERSION != h->version) || (((uint32_t)sizeof(vertexRecord) << 16 | (uint32_t)sizeof(edgeRecord)) != h->recordSizes) )
+    return;
+  if( (h->space < SPACE_SE3) || (SPACE_RT3 < h->space) )
+    return;
+
+  // check that the records are aligned and within the data
+  if( (0 != h->vertexOffset % 16) || (0 != h->edgeOffset % 16) || (0 != ((size_t)adata) % 16) )
+    return;
+  if( (asize < h->vertexOffset) || ((asize - h->vertexOffset)/sizeof(vertexRecord) < h->nvertices) ||
+      (asize < h->edgeOffset)   || ((asize - h->edgeOffset)/sizeof(edgeRecord)     < h->nedges) )
+    return;
+  header = h;
+}
+
+
+
+//
+// does the data start with the magic
+//
+bool binaryGraph::isBinary( const char *adata, const size_t asize )
+{
+  return (8 <= asize) && (0 == memcmp( adata, BINARY_MAGIC, 8 ));
+}
+
+
+
+//
+// is the data a complete binary graph
+//
+bool binaryGraph::good( void ) const
+{
+  return 0 != header;
+}
+
+
+
+//
+// the solution space
+//
+int binaryGraph::space( void ) const
+{
+  return header->space;
+}
+
+
+
+//
+// the number of vertices
+//
+size_t binaryGraph::nvertices( void ) const
+{
+  return header->nvertices;
+}
+
+
+
+//
+// the number of edges
+//
+size_t binaryGraph::nedges( void ) const
+{
+  return header->nedges;
+}
+
+
+
+//
+// the vertices
+//
+const vertexRecord *binaryGraph::vertices( void ) const
+{
+  return (const vertexRecord*)(data + header->vertexOffset);
+}
+
+
+
+//
+// the edges
+//
+const edgeRecord *binaryGraph::edges( void ) const
+{
+  return (const edgeRecord*)(data + header->edgeOffset);
+}
+
+
+
+//
+// write a binary graph file
+//
+bool binaryGraph::write( const string &aname, const int aspace, const vector<vertexRecord> &avertices, const vector<edgeRecord> &aedges )
+{
+  if( !littleEndian() )
+    return false;
+
+  // the header, the records start at multiples of 16 bytes
+  binaryHeader h;
+  memset( &h, 0, sizeof(h) );
+  memcpy( h.magic, BINARY_MAGIC, 8 );
+  h.version      = BINARY_VERSION;
+  h.space        = aspace;
+  h.nvertices    = avertices.size();
+  h.nedges       = aedges.size();
+  h.vertexOffset = sizeof(binaryHeader);
+  h.edgeOffset   = h.vertexOffset + ((avertices.size()*sizeof(vertexRecord) + 15)/16)*16;
+  h.recordSizes  = (uint32_t)sizeof(vertexRecord) << 16 | (uint32_t)sizeof(edgeRecord);
+
+  // write the header and the records
+  FILE *file = fopen( aname.c_str(), "wb" );
+  if( file == NULL )
+    return false;
+  static const char zeros[16] = { 0 };
+  size_t padding = h.edgeOffset - h.vertexOffset - avertices.size()*sizeof(vertexRecord);
+  bool   ok      = (1 == fwrite( &h, sizeof(h), 1, file ));
+  if( ok && !avertices.empty() )
+    ok = (avertices.size() == fwrite( &avertices[0], sizeof(vertexRecord), avertices.size(), file ));
+  if( ok && (0 < padding) )
+    ok = (padding == fwrite( zeros, 1, padding, file ));
+  if( ok && !aedges.empty() )
+    ok = (aedges.size() == fwrite( &aedges[0], sizeof(edgeRecord), aedges.size(), file ));
+  return (0 == fclose( file )) && ok;
+}
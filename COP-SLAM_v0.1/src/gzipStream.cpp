@@ -0,0 +1,272 @@
+
+
+
+#include <cstring>
+#include <algorithm>
+#include "gzipStream.hpp"
+
+
+
+//
+// does the data start with the gzip magic
+//
+bool isGzip( const char *adata, const size_t asize )
+{
+  return (2 <= asize) && ((unsigned char)adata[0] == 0x1f) && ((unsigned char)adata[1] == 0x8b);
+}
+
+
+
+//
+// decompress gzip data, the size of the contents is taken from the trailer of the last member
+//
+bool gunzip( const char *adata, const size_t asize, vector<char> &acontents )
+{
+  z_stream stream;
+  memset( &stream, 0, sizeof(stream) );
+  if( Z_OK != inflateInit2( &stream, 16+MAX_WBITS ) )
+    return false;
+
+  // the trailer holds the size modulo 2^32, the contents grow when it is too small
+  size_t expected = 0;
+  if( 4 <= asize )
+    for( int i = 3; 0 <= i; i-- )
+      expected = (expected << 8) | (unsigned char)adata[asize-4+i];
+  acontents.resize( max( expected, (size_t)GZIP_BLOCK ) );
+
+  // inflate all members
+  size_t produced = 0;
+  size_t consumed = 0;
+  int    result   = Z_OK;
+  while( true )
+  {
+    if( acontents.size() == produced )
+      acontents.resize( 2*acontents.size() );
+    size_t inBlock  = min( asize-consumed, (size_t)1 << 30 );
+    size_t outBlock = min( acontents.size()-produced, (size_t)1 << 30 );
+    stream.next_in   = (Bytef*)adata + consumed;
+    stream.avail_in  = inBlock;
+    stream.next_out  = (Bytef*)&acontents[produced];
+    stream.avail_out = outBlock;
+    result    = inflate( &stream, Z_NO_FLUSH );
+    consumed += inBlock  - stream.avail_in;
+    produced += outBlock - stream.avail_out;
+    if( (Z_STREAM_END == result) && (consumed < asize) )
+      result = inflateReset( &stream );
+    else if( Z_STREAM_END == result )
+      break;
+    if( (Z_OK != result) && (Z_BUF_ERROR != result) )
+      break;
+    if( (Z_BUF_ERROR == result) && (consumed == asize) )
+      break;
+  }
+  inflateEnd( &stream );
+  acontents.resize( produced );
+  return Z_STREAM_END == result;
+}
+
+
+
+//
+// constructor
+//
+gzipInBuf::gzipInBuf( streambuf *asource )
+{
+  source = asource;
+  ended  = false;
+  failed = false;
+  in.resize(  GZIP_BLOCK );
+  out.resize( GZIP_BLOCK );
+  memset( &stream, 0, sizeof(stream) );
+  if( Z_OK != inflateInit2( &stream, 16+MAX_WBITS ) )
+    failed = true;
+  setg( &out[0], &out[0], &out[0] );
+}
+
+
+
+//
+// destructor
+//
+gzipInBuf::~gzipInBuf()
+{
+  inflateEnd( &stream );
+}
+
+
+
+//
+// is the data read so far valid and, at its end, complete
+//
+bool gzipInBuf::good( void ) const
+{
+  return !failed;
+}
+
+
+
+//
+// decompress the next block
+// only the compressed data that is available is read, at least one byte such that the call waits for data
+//
+gzipInBuf::int_type gzipInBuf::underflow( void )
+{
+  if( gptr() < egptr() )
+    return traits_type::to_int_type( *gptr() );
+  if( failed )
+    return traits_type::eof();
+
+  stream.next_out  = (Bytef*)&out[0];
+  stream.avail_out = out.size();
+  while( stream.avail_out == out.size() )
+  {
+    // more compressed data
+    if( 0 == stream.avail_in )
+    {
+      streamsize n = source->in_avail();
+      n = source->sgetn( &in[0], min( max( n, (streamsize)1 ), (streamsize)in.size() ) );
+      if( n <= 0 )
+      {
+	failed = !ended;
+	return traits_type::eof();
+      }
+      stream.next_in  = (Bytef*)&in[0];
+      stream.avail_in = n;
+    }
+
+    // the next member starts after the end of a member
+    int result = inflate( &stream, Z_NO_FLUSH );
+    if( Z_STREAM_END == result )
+    {
+      ended = (Z_OK == inflateReset( &stream ));
+      if( !ended )
+	failed = true;
+    }
+    else if( (Z_OK == result) || (Z_BUF_ERROR == result) )
+      ended = false;
+    else
+      failed = true;
+    if( failed )
+      return traits_type::eof();
+  }
+  setg( &out[0], &out[0], &out[0] + (out.size()-stream.avail_out) );
+  return traits_type::to_int_type( *gptr() );
+}
+
+
+
+//
+// is there compressed data available, such that reading does not have to wait
+//
+streamsize gzipInBuf::showmanyc( void )
+{
+  if( failed )
+    return -1;
+  return ((0 < stream.avail_in) || (0 < source->in_avail())) ? 1 : 0;
+}
+
+
+
+//
+// constructor
+//
+gzipOutBuf::gzipOutBuf( streambuf *atarget, const int alevel )
+{
+  target = atarget;
+  closed = false;
+  failed = false;
+  in.resize(  GZIP_BLOCK );
+  out.resize( GZIP_BLOCK );
+  memset( &stream, 0, sizeof(stream) );
+  if( Z_OK != deflateInit2( &stream, alevel, Z_DEFLATED, 16+MAX_WBITS, 8, Z_DEFAULT_STRATEGY ) )
+    failed = true;
+  setp( &in[0], &in[0] + in.size() );
+}
+
+
+
+//
+// destructor
+//
+gzipOutBuf::~gzipOutBuf()
+{
+  close();
+  deflateEnd( &stream );
+}
+
+
+
+//
+// finish the data
+//
+bool gzipOutBuf::close( void )
+{
+  if( !closed )
+  {
+    closed = true;
+    compress( Z_FINISH );
+    if( -1 == target->pubsync() )
+      failed = true;
+  }
+  return !failed;
+}
+
+
+
+//
+// compress the buffer and store ac
+//
+gzipOutBuf::int_type gzipOutBuf::overflow( int_type ac )
+{
+  if( closed || !compress( Z_NO_FLUSH ) )
+    return traits_type::eof();
+  if( !traits_type::eq_int_type( ac, traits_type::eof() ) )
+  {
+    *pptr() = traits_type::to_char_type( ac );
+    pbump( 1 );
+  }
+  return traits_type::not_eof( ac );
+}
+
+
+
+//
+// compress and flush the buffer, such that everything written so far can be decompressed
+//
+int gzipOutBuf::sync( void )
+{
+  if( closed )
+    return failed ? -1 : 0;
+  if( !compress( Z_SYNC_FLUSH ) || (-1 == target->pubsync()) )
+    return -1;
+  return 0;
+}
+
+
+
+//
+// compress the buffer with the given zlib flush mode and write the compressed data to the target
+//
+bool gzipOutBuf::compress( const int aflush )
+{
+  if( failed )
+    return false;
+  stream.next_in  = (Bytef*)pbase();
+  stream.avail_in = pptr() - pbase();
+  int result;
+  do
+  {
+    stream.next_out  = (Bytef*)&out[0];
+    stream.avail_out = out.size();
+    result = deflate( &stream, aflush );
+    streamsize n = out.size() - stream.avail_out;
+    if( (Z_STREAM_ERROR == result) || (n != target->sputn( &out[0], n )) )
+    {
+      failed = true;
+      return false;
+    }
+  }
+  while( (0 == stream.avail_out) || ((Z_FINISH == aflush) && (Z_STREAM_END != result)) );
+  setp( &in[0], &in[0] + in.size() );
+  return true;
+}
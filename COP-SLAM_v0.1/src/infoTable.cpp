@@ -0,0 +1,183 @@
+
+
+
+#include <cstring>
+#include "infoTable.hpp"
+#include "simdKernels.hpp"
+
+
+
+//
+// constructor
+//
+infoTable::infoTable( void )
+{
+  clear();
+}
+
+
+
+//
+// remove all entries
+//
+void infoTable::clear( void )
+{
+  entries.clear();
+  slots.assign( 64, -1 );
+  weighted = 0;
+}
+
+
+
+//
+// the number of entries
+//
+int infoTable::size( void ) const
+{
+  return entries.size();
+}
+
+
+
+//
+// make sure an entries can be inserted without allocating, the slots are at least twice the entries
+//
+void infoTable::reserve( const int an )
+{
+  entries.reserve( an );
+  if( slots.size() < 2*(size_t)an )
+  {
+    size_t nslots = slots.size();
+    while( nslots < 2*(size_t)an )
+      nslots *= 2;
+    slots.resize( nslots/2 );
+    grow();
+  }
+}
+
+
+
+//
+// the index of the entry with the given values, without weights for a new entry
+//
+int infoTable::insert( const float *ainfo )
+{
+  uint32_t hash = hashInfo( ainfo );
+  size_t   mask = slots.size()-1;
+  for( size_t s = hash & mask; ; s = (s+1) & mask )
+  {
+    int k = slots[s];
+    if( k < 0 )
+    {
+      entry e;
+      memcpy( e.info, ainfo, sizeof(e.info) );
+      e.hash = hash;
+      e.tra  = 0.0;
+      e.rot  = 0.0;
+      slots[s] = entries.size();
+      entries.push_back( e );
+      if( slots.size() < 2*entries.size() )
+	grow();
+      return entries.size()-1;
+    }
+    if( (entries[k].hash == hash) && (0 == memcmp( entries[k].info, ainfo, sizeof(entries[k].info) )) )
+      return k;
+  }
+}
+
+
+
+//
+// the index of the entry with the given values and weights
+// the weights of an existing entry are kept, they follow from the same values
+//
+int infoTable::insert( const float *ainfo, const double atra, const double arot )
+{
+  int n = entries.size();
+  int k = insert( ainfo );
+  if( k == n )
+  {
+    entries[k].tra = atra;
+    entries[k].rot = arot;
+    if( weighted == k )
+      weighted++;
+  }
+  return k;
+}
+
+
+
+//
+// compute the weights of the new entries
+//
+void infoTable::weigh( void )
+{
+  if( weighted < (int)entries.size() )
+    packedWeights( entries.size()-weighted, sizeof(entry), entries[weighted].info, &entries[weighted].tra, &entries[weighted].rot );
+  weighted = entries.size();
+}
+
+
+
+//
+// the values of an entry
+//
+const float *infoTable::info( const int an ) const
+{
+  return entries[an].info;
+}
+
+
+
+//
+// the translation weight of an entry
+//
+double infoTable::tra( const int an ) const
+{
+  return entries[an].tra;
+}
+
+
+
+//
+// the rotation weight of an entry
+//
+double infoTable::rot( const int an ) const
+{
+  return entries[an].rot;
+}
+
+
+
+//
+// FNV-1a hash of the bits of the values
+//
+uint32_t infoTable::hashInfo( const float *ainfo )
+{
+  uint32_t hash = 2166136261u;
+  uint32_t bits;
+  for( int k = 0; k < 21; k++ )
+  {
+    memcpy( &bits, ainfo+k, sizeof(bits) );
+    hash = (hash ^ bits) * 16777619u;
+  }
+  return hash ^ (hash >> 16);
+}
+
+
+
+//
+// double the number of slots and re-insert the entries
+//
+void infoTable::grow( void )
+{
+  slots.assign( 2*slots.size(), -1 );
+  size_t mask = slots.size()-1;
+  for( int k = 0; k < (int)entries.size(); k++ )
+  {
+    size_t s = entries[k].hash & mask;
+    while( 0 <= slots[s] )
+      s = (s+1) & mask;
+    slots[s] = k;
+  }
+}
@@ -3,6 +3,7 @@
 
 #include <iostream>
 #include <sys/time.h>
+#include <sys/stat.h>
 #include "poseIO.hpp"
 
 
@@ -12,63 +13,36 @@ using namespace std;
 
 
 //
-// demo program for COP-SLAM
+// run COP-SLAM on a pose chain with the given storage and accumulation types
 //
-int main(int argc, char** argv)
+template<typename Storage, typename Accum>
+int runDemo( const string &inputFile, const string &outputFile, const string &method, const string &loadMode, const string &storeDirectory, const bool sparse )
 {
   
    // used to measure computation time
    struct timeval t0;
    struct timeval t1;
-      
-   // input and output files for the demo program
-   string inputFile;
-   string outputFile;
    
    
-   // method to be used
-   string method;
-   
-   
-   // go through command line input
-   if( argc < 3 )
-   {
-      cout << endl << "COP-SLAM DEMO PROGRAM "; 
-      cout << endl << "usage: copslam <input-file> <output-file>  [one-pass | two-pass (default)]" << endl << endl;     
-      return 0;
-   }
-   else if ( argc < 4 )
-   {
-	inputFile  = argv[1];
-        outputFile = argv[2];
-	method     = "two-pass";
-   }
-   else  
-   {
-      inputFile  = argv[1];
-      outputFile = argv[2];
-      method     = argv[3];
-      if( (method != "one-pass") && (method != "two-pass") && (method != "no-scale"))
-      {
-	  cout << endl << "[WARNING] Method " << method << " not known." << endl;
-	  method = "two-pass";
-	  cout << "[WARNING] Using default " << method << " instead." << endl;
-      }
-   }
-       
-      
    // create instances of COP-SLAM and poseIO classes
-   poseIO  poseio;
+   poseIO<Storage,Accum> poseio;
    
    
    // start of demo program  
    cout << endl << "Starting COP-SLAM demo program." << endl << endl;
+   cout << "Pose chain precision: " << sizeof(Storage)*8 << " bit storage, " << sizeof(Accum)*8 << " bit accumulation" << endl << endl;
       
    
    // set the input files
    poseio.setInputFile(inputFile);
    poseio.setOutputFile(outputFile);
    poseio.setMethod(method);
+   poseio.setLoadMode(loadMode);
+   if( !storeDirectory.empty() && !poseio.setStore( storeDirectory ) )
+   {
+       cerr << "Unable to create pose store in: " << storeDirectory << endl;
+       return 1;
+   }
    
    
    // user feedback  
@@ -91,6 +65,14 @@ int main(int argc, char** argv)
    }
       
       
+   // merge the stationary and slow stretches of the chain
+   if( sparse )
+   {
+       int removed = poseio.sparsifyChain();
+       cout << "Sparse chain: " << poseio.size() << " absolute poses, " << removed << " merged" << endl;
+   }
+   
+   
    // start timer
    cout << endl << "Starting COP-SLAM." << endl;
    poseio.printMethod(    cout );
@@ -111,11 +93,254 @@ int main(int argc, char** argv)
    cout << endl << "Processing time: " << (int)(elapsed/1000.0f) << " milli seconds (file I/O not included)" << endl << endl;
    
       
-   // write the output to file
+   // write the output to file, with the merged poses interpolated
+   poseio.expandChain();
    poseio.writeOutputFile();
       
       
    // the loop is closed
    cout << endl << "Finished with COP-SLAM demo program" << endl << endl;
    return 0;  
-}
\ No newline at end of file
+}
+
+
+
+//
+// is the input a stream, i.e. standard input or a named pipe
+//
+bool isStream( const string &inputFile )
+{
+   struct stat status;
+   if( inputFile == "-" )
+     return true;
+   return (0 == stat( inputFile.c_str(), &status )) && S_ISFIFO( status.st_mode );
+}
+
+
+
+//
+// run COP-SLAM on a pose chain while it is read from a stream
+// the output is the stream of new and corrected absolute poses, when it is
+// standard output the user feedback goes to standard error instead
+//
+template<typename Storage, typename Accum>
+int runStream( const string &inputFile, const string &outputFile, const string &method, const string &storeDirectory )
+{
+  
+   // used to measure computation time
+   struct timeval t0;
+   struct timeval t1;
+   
+   
+   // the buffers of the streams are not synchronized with stdio
+   // such that a partial line of input can be detected
+   ios::sync_with_stdio( false );
+   ostream   stdOutput( cout.rdbuf() );
+   streambuf *feedback = cout.rdbuf();
+   if( outputFile == "-" )
+     cout.rdbuf( cerr.rdbuf() );
+   
+   
+   // create instance of the poseIO class
+   poseIO<Storage,Accum> poseio;
+   poseio.setMethod(method);
+   if( !storeDirectory.empty() && !poseio.setStore( storeDirectory ) )
+   {
+      cerr << "Unable to create pose store in: " << storeDirectory << endl;
+      cout.rdbuf( feedback );
+      return 1;
+   }
+   
+   
+   // start of demo program  
+   cout << endl << "Starting COP-SLAM demo program on a stream." << endl << endl;
+   cout << "Pose chain precision: " << sizeof(Storage)*8 << " bit storage, " << sizeof(Accum)*8 << " bit accumulation" << endl << endl;
+   poseio.printMethod( cout );
+   
+   
+   // open the input and output
+   ifstream inFile;
+   ofstream outFile;
+   istream  *input  = &cin;
+   ostream  *output = &stdOutput;
+   if( inputFile != "-" )
+   {
+      inFile.open( inputFile.c_str(), ios::in );
+      if( !inFile )
+      {
+	 cerr << "Unable to open input file: " << inputFile << endl;
+	 cout.rdbuf( feedback );
+	 return 1;
+      }
+      input = &inFile;
+   }
+   if( outputFile != "-" )
+   {
+      outFile.open( outputFile.c_str(), ios::out );
+      if( !outFile )
+      {
+	 cerr << "Unable to create output file: " << outputFile << endl;
+	 cout.rdbuf( feedback );
+	 return 1;
+      }
+      output = &outFile;
+   }
+   
+   
+   // gzip compressed input is decompressed while it is read, an output file ending in .gz is compressed while it is written
+   unique_ptr<gzipInBuf>  decompressor;
+   unique_ptr<gzipOutBuf> compressor;
+   istream                gzipInput( 0 );
+   ostream                gzipOutput( 0 );
+   if( 0x1f == input->rdbuf()->sgetc() )
+   {
+      decompressor.reset( new gzipInBuf( input->rdbuf() ) );
+      gzipInput.rdbuf( decompressor.get() );
+      input = &gzipInput;
+   }
+   if( (outputFile != "-") && (3 <= outputFile.size()) && (0 == outputFile.compare( outputFile.size()-3, 3, ".gz" )) )
+   {
+      compressor.reset( new gzipOutBuf( outFile.rdbuf() ) );
+      gzipOutput.rdbuf( compressor.get() );
+      output = &gzipOutput;
+   }
+   
+   
+   // run COP-SLAM while reading
+   gettimeofday(&t0,0);
+   bool ok = poseio.streamGraph( *input, *output );
+   if( decompressor && !decompressor->good() )
+   {
+      cerr << "Corrupt or truncated compressed input: " << inputFile << endl;
+      ok = false;
+   }
+   if( compressor && !compressor->close() )
+   {
+      cerr << "Unable to write output file: " << outputFile << endl;
+      ok = false;
+   }
+   gettimeofday(&t1,0);
+   
+   
+   // user feedback on processing time
+   long elapsed = (t1.tv_sec-t0.tv_sec)*1000000 + t1.tv_usec-t0.tv_usec;
+   cout << endl << "Processing time: " << (int)(elapsed/1000.0f) << " milli seconds (file I/O included)" << endl << endl;
+   cout << endl << "Finished with COP-SLAM demo program" << endl << endl;
+   cout.rdbuf( feedback );
+   return ok ? 0 : 1;
+}
+
+
+
+//
+// demo program for COP-SLAM
+//
+int main(int argc, char** argv)
+{
+  
+   // input and output files for the demo program
+   string inputFile;
+   string outputFile;
+   
+   
+   // method to be used
+   string method;
+   
+   
+   // scalar type of the pose chain
+   string precision = "float";
+   
+   
+   // read all vertices or only the first one
+   string loadMode = "full-load";
+   
+   
+   // directory of the files of a disk-backed pose chain, empty to keep the chain in memory
+   string storeDirectory;
+   
+   
+   // merge the stationary and slow stretches of the chain before running COP-SLAM
+   bool sparse = false;
+   
+   
+   // go through command line input
+   if( argc < 3 )
+   {
+      cout << endl << "COP-SLAM DEMO PROGRAM "; 
+      cout << endl << "usage: copslam <input-file> <output-file>  [one-pass | two-pass (default) | no-scale]  [float (default) | double | mixed]  [full-load (default) | fast-load]  [<store-directory>]  [dense (default) | sparse]" << endl;
+      cout << "       an input file - (standard input) or a named pipe is processed while it is read, an output file - is standard output" << endl;
+      cout << "       the input may be a binary graph (see copslamconvert), an output file ending in .bin is written as binary graph" << endl;
+      cout << "       gzip compressed input is decompressed while it is read, an output file ending in .gz is compressed" << endl;
+      cout << "       fast-load reads only the first vertex of a g2o file, the other absolute poses follow from the edges" << endl;
+      cout << "       with a store directory the poses are kept in files in it, of which a bounded part stays in memory" << endl;
+      cout << "       sparse merges the relative poses of stationary and slow stretches, they are interpolated in the output" << endl << endl;     
+      return 0;
+   }
+   else if ( argc < 4 )
+   {
+	inputFile  = argv[1];
+        outputFile = argv[2];
+	method     = "two-pass";
+   }
+   else  
+   {
+      inputFile  = argv[1];
+      outputFile = argv[2];
+      method     = argv[3];
+      if( (method != "one-pass") && (method != "two-pass") && (method != "no-scale"))
+      {
+	  cout << endl << "[WARNING] Method " << method << " not known." << endl;
+	  method = "two-pass";
+	  cout << "[WARNING] Using default " << method << " instead." << endl;
+      }
+      if( 4 < argc )
+	precision = argv[4];
+      if( (precision != "float") && (precision != "double") && (precision != "mixed"))
+      {
+	  cout << endl << "[WARNING] Precision " << precision << " not known." << endl;
+	  precision = "float";
+	  cout << "[WARNING] Using default " << precision << " instead." << endl;
+      }
+      if( 5 < argc )
+	loadMode = argv[5];
+      if( (loadMode != "full-load") && (loadMode != "fast-load") )
+      {
+	  cout << endl << "[WARNING] Load mode " << loadMode << " not known." << endl;
+	  loadMode = "full-load";
+	  cout << "[WARNING] Using default " << loadMode << " instead." << endl;
+      }
+      for( int k = 6; k < argc; k++ )
+      {
+	  string option = argv[k];
+	  if( (option == "sparse") || (option == "dense") )
+	    sparse = (option == "sparse");
+	  else
+	    storeDirectory = option;
+      }
+   }
+   
+   
+   // run the demo on a stream with the requested scalar types
+   if( isStream( inputFile ) )
+   {
+      if( sparse )
+	cerr << "[WARNING] A stream is not sparsified, its loop closures are not known in advance." << endl;
+      if( precision == "double" )
+	return runStream<double,double>( inputFile, outputFile, method, storeDirectory );
+      else if( precision == "mixed" )
+	return runStream<float,double>( inputFile, outputFile, method, storeDirectory );
+      else
+	return runStream<float,float>( inputFile, outputFile, method, storeDirectory );
+   }
+   
+   
+   // run the demo with the requested scalar types
+   if( precision == "double" )
+     return runDemo<double,double>( inputFile, outputFile, method, loadMode, storeDirectory, sparse );
+   else if( precision == "mixed" )
+     return runDemo<float,double>( inputFile, outputFile, method, loadMode, storeDirectory, sparse );
+   else
+     return runDemo<float,float>( inputFile, outputFile, method, loadMode, storeDirectory, sparse );
+}
+       
+      
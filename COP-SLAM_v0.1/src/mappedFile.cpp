@@ -0,0 +1,109 @@
+
+
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "mappedFile.hpp"
+#include "gzipStream.hpp"
+
+
+
+//
+// constructor
+//
+mappedFile::mappedFile( const string &aname )
+{
+  buffer = 0;
+  length = 0;
+  mapped = false;
+  opened = false;
+  
+  int fd = open( aname.c_str(), O_RDONLY );
+  if( fd < 0 )
+    return;
+  opened = true;
+  
+  // map regular files, the file is read sequentially
+  struct stat status;
+  if( (0 == fstat( fd, &status )) && S_ISREG( status.st_mode ) && (0 < status.st_size) )
+  {
+    void *map = mmap( 0, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    if( map != MAP_FAILED )
+    {
+      madvise( map, status.st_size, MADV_SEQUENTIAL );
+      buffer = (const char*)map;
+      length = status.st_size;
+      mapped = true;
+    }
+  }
+  
+  // otherwise read everything
+  if( !mapped )
+  {
+    char    block[65536];
+    ssize_t n;
+    while( 0 < (n = read( fd, block, sizeof(block) )) )
+      copy.insert( copy.end(), block, block+n );
+    if( n < 0 )
+      opened = false;
+    buffer = copy.empty() ? 0 : &copy[0];
+    length = copy.size();
+  }
+  close( fd );
+  
+  // gzip compressed files are decompressed from the mapping or the buffer, the contents replace them
+  if( opened && isGzip( buffer, length ) )
+  {
+    vector<char> contents;
+    opened = gunzip( buffer, length, contents );
+    if( mapped )
+      munmap( (void*)buffer, length );
+    mapped = false;
+    copy.swap( contents );
+    buffer = copy.empty() ? 0 : &copy[0];
+    length = copy.size();
+  }
+}
+
+
+
+//
+// destructor
+//
+mappedFile::~mappedFile()
+{
+  if( mapped )
+    munmap( (void*)buffer, length );
+}
+
+
+
+//
+// is the file opened
+//
+bool mappedFile::good( void ) const
+{
+  return opened;
+}
+
+
+
+//
+// the contents of the file
+//
+const char *mappedFile::data( void ) const
+{
+  return buffer;
+}
+
+
+
+//
+// the number of bytes
+//
+size_t mappedFile::size( void ) const
+{
+  return length;
+}
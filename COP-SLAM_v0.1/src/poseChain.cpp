@@ -3,19 +3,34 @@
 
 
 #include "poseChain.hpp"
+#include "lieKernels.hpp"
+#include "simdKernels.hpp"
 
 
 
 //
 // constructor
 //
-poseChain::poseChain( void )
+template<typename Storage, typename Accum>
+poseChain<Storage,Accum>::poseChain( void )
 {
-  naposes          = 0;
-  nclosures        = 0;
-  scaleCloseFactor = 0.0f;
-  scaleNormalizer  = 1.0f;
-  globalNormalizer = 1.0f;
+  naposes           = 0;
+  nposes            = 0;
+  nclosures         = 0;
+  nprocessed        = 0;
+  integrated        = 0;
+  prevEnd           = 0;
+  doNormalize       = 0;
+  method            = TWOPASS;
+  scaleCloseFactor  = 0.0f;
+  scaleNormalizer   = 1.0f;
+  globalNormalizer  = 1.0f;
+  parallelThreshold = PARALLEL_THRESHOLD;
+  steady            = false;
+  se3_solution_space         = true;  // default SE(3) is the solution space
+  rt3_solution_space         = false;
+  sim3_solution_space        = false;
+  ignore_sim3_solution_space = false;
 }
 
 
@@ -23,9 +38,10 @@ poseChain::poseChain( void )
 //
 // make sure internal variables are corretly updated
 //
-void poseChain::syncChain( void )
+template<typename Storage, typename Accum>
+void poseChain<Storage,Accum>::syncChain( void )
 {
-  naposes   = poseVector.size()/4;
+  naposes   = absVector.size();
   nclosures = closeVector.size();
 }
 
@@ -34,7 +50,8 @@ void poseChain::syncChain( void )
 //
 // return the number of absolute poses
 //
-int poseChain::size( void )
+template<typename Storage, typename Accum>
+int poseChain<Storage,Accum>::size( void )
 {
   return naposes;
 }
@@ -44,209 +61,671 @@ int poseChain::size( void )
 //
 // run COP-SLAM on the pose chain
 //
-void poseChain::copSLAM( void )
+template<typename Storage, typename Accum>
+void poseChain<Storage,Accum>::copSLAM( void )
 {
       
    // go through all (loop closure) poses sequentially
    // this simulates an online approach
-   int  start    = 0;
-   int  end      = 0;
-   int  prev_end = 0;
-   int  doNormalize = 0;
-   bool orientation_only = false;
-   Eigen::Affine3f   lcupdate;
-   Eigen::Vector3f   normalizers;
-   Eigen::AngleAxisf aa;
-   for( int n = 0; n < closeVector.size(); n++ )   
-   {          
-     
-      // get start and end pose
-      start = startVector[n];
-      end   = endVector[n];
-      cout << "Loop " << n << " from " << start << " to " << end << " (" << end-start << ")" << endl;
-      if( prev_end <= end )
+   allocationCheck check( steady );
+   for( ; nprocessed < closeVector.size(); nprocessed++ )   
+     processClosure( nprocessed );
+   
+   // integrate trajectory upto final time-step
+   integrateChain( integrated, size()-1, false );
+   integrated = size()-1;
+   
+}
+
+
+
+//
+// keep the poses in files instead of in memory, the resident bytes are shared by the three stores
+//
+template<typename Storage, typename Accum>
+bool poseChain<Storage,Accum>::setStore( const string &adirectory, const size_t aresident )
+{
+   return absVector.backing(  adirectory, aresident/3 ) &&
+          relVector.backing(  adirectory, aresident/3 ) &&
+          origVector.backing( adirectory, aresident/3 );
+}
+
+
+
+//
+// the allocator of the segments of all stores
+//
+template<typename Storage, typename Accum>
+void poseChain<Storage,Accum>::setAllocator( chainAllocator &aallocator )
+{
+   absVector.setAllocator( aallocator );
+   relVector.setAllocator( aallocator );
+   origVector.setAllocator( aallocator );
+   closeVector.setAllocator( aallocator );
+   traInfoVector.setAllocator( aallocator );
+   rotInfoVector.setAllocator( aallocator );
+   scaleInfoVector.setAllocator( aallocator );
+   traCloseInfoVector.setAllocator( aallocator );
+   rotCloseInfoVector.setAllocator( aallocator );
+   infoIndexVector.setAllocator( aallocator );
+   infoCloseIndexVector.setAllocator( aallocator );
+   startVector.setAllocator( aallocator );
+   endVector.setAllocator( aallocator );
+   sparseIndex.setAllocator( aallocator );
+}
+
+
+
+//
+// size the chain for its steady state
+//
+template<typename Storage, typename Accum>
+void poseChain<Storage,Accum>::presize( const int aposes, const int aclosures, const int ainfos )
+{
+   absVector.reserve( aposes );
+   relVector.reserve( aposes );
+   origVector.reserve( aposes );
+   traInfoVector.reserve( aposes );
+   rotInfoVector.reserve( aposes );
+   scaleInfoVector.reserve( aposes );
+   infoIndexVector.reserve( aposes );
+   closeVector.reserve( aclosures );
+   traCloseInfoVector.reserve( aclosures );
+   rotCloseInfoVector.reserve( aclosures );
+   infoCloseIndexVector.reserve( aclosures );
+   startVector.reserve( aclosures );
+   endVector.reserve( aclosures );
+   infos.reserve( ainfos );
+   
+   // the scratch of the parallel sweeps
+   chunkFirst.reserve( pool.size()+1 );
+   chunkPrefix.reserve( pool.size() );
+   chunkCorrections.reserve( pool.size() );
+   steady = true;
+}
+
+
+
+//
+// merge the runs of consecutive relative poses with little motion, in place since a merged pose is never
+// stored after the poses it merges
+//
+template<typename Storage, typename Accum>
+int poseChain<Storage,Accum>::sparsifyChain( const Accum adistance, const Accum aangle )
+{
+   // only a chain of which no loop closure has been processed yet, and only once
+   if( (0 < nprocessed) || (0 < sparseIndex.size()) || (naposes < 3) )
+     return 0;
+   
+   // the poses of the loop closures and the last pose are kept, sparse[n] is the new index of kept pose n
+   vector<int> sparse( naposes, -1 );
+   sparse[0]         = 0;
+   sparse[naposes-1] = 0;
+   for( int m = 0; m < nclosures; m++ )
+   {
+      sparse[startVector[m]] = 0;
+      sparse[endVector[m]]   = 0;
+   }
+   
+   // the run of relative poses since the last kept pose, with its summed weights
+   sim3Accum    run   = sim3Accum::Identity();
+   sim3Accum    next;
+   Accum        tra   = Accum(0);
+   Accum        rot   = Accum(0);
+   Accum        scale = Accum(0);
+   int          count = 0;
+   int          k     = 0;
+   vector3Accum axis;
+   Accum        angle;
+   
+   // store the run as relative pose k, ending in absolute pose aend
+   auto store = [&]( const int aend )
+   {
+      k++;
+      relVector.touch( k, k );
+      absVector.touch( k, k );
+      absVector.touch( aend, aend );
+      relVector[k] = run.template cast<Storage>();
+      absVector[k] = absVector[aend];
+      traInfoVector.set(   k, tra );
+      rotInfoVector.set(   k, rot );
+      scaleInfoVector.set( k, scale );
+      sparseIndex.push_back( aend );
+      sparse[aend] = k;
+      run   = sim3Accum::Identity();
+      tra   = Accum(0);
+      rot   = Accum(0);
+      scale = Accum(0);
+      count = 0;
+   };
+   
+   // go through the relative poses
+   sparseIndex.assign( 1, 0 );
+   for( int n = 1; n < naposes; n++ )
+   {
+      relVector.touch( n, n );
+      next = run*relVector[n].template cast<Accum>();
+      so3Log( next.R, axis, angle );
+      
+      // a run ends before the relative pose that moves it too far
+      if( (0 < count) && ((adistance < next.t.norm()) || (aangle < angle)) )
       {
-	cout << "Closing" << endl;
-	
-	// integrate trajectory upto current time-step
-	if( prev_end < start )
-	  integrateChain( prev_end, start, false );      
-	
-	// what kind (regular or orientation-only) of loop is it
-	orientation_only = false;      	
-	if( !(traCloseInfoVector(n) < 4.5e9) )
-	{
-	  cout << "ORIENTATION-ONLY" << endl; 
-	  orientation_only = true;
-	}
+	store( n-1 );
+	next = relVector[n].template cast<Accum>();
+      }
+      run    = next;
+      tra   += traInfoVector.get( n );
+      rot   += rotInfoVector.get( n );
+      scale += scaleInfoVector.get( n );
+      count++;
+      
+      // and at a kept pose
+      if( 0 == sparse[n] )
+	store( n );
+   }
+   
+   // nothing merged
+   if( k == naposes-1 )
+   {
+      sparseIndex.clear();
+      return 0;
+   }
+   
+   // the loop closures refer to the kept poses
+   for( int m = 0; m < nclosures; m++ )
+   {
+      startVector[m] = sparse[startVector[m]];
+      endVector[m]   = sparse[endVector[m]];
+   }
+   
+   // the sparse chain
+   int removed = naposes-(k+1);
+   absVector.resize( k+1, sim3Store::Identity() );
+   relVector.resize( k+1, sim3Store::Identity() );
+   traInfoVector.resize( k+1 );
+   rotInfoVector.resize( k+1 );
+   scaleInfoVector.resize( k+1 );
+   naposes    = k+1;
+   nposes     = k;
+   integrated = 0;
+   prevEnd    = 0;
+   return removed;
+}
+
+
+
+//
+// restore the original poses of a sparsified chain
+// the correction of a merged run, i.e. the difference between its kept end pose and the end of its original
+// poses integrated from its kept start pose, is distributed over the run by the original weights like a loop-closure
+// update, its rotation by the rotation weights, its translation by the translation weights and its scale evenly
+// the runs are expanded from the last one backwards, such that the poses of a run only overwrite merged poses
+// that have been expanded already
+//
+template<typename Storage, typename Accum>
+void poseChain<Storage,Accum>::expandChain( void )
+{
+   if( 0 == sparseIndex.size() )
+     return;
+   
+   // grow the chain to its original size
+   int nsparse = naposes;
+   int nfull   = origVector.size();
+   absVector.resize( nfull, sim3Store::Identity() );
+   relVector.resize( nfull, sim3Store::Identity() );
+   traInfoVector.resize( nfull );
+   rotInfoVector.resize( nfull );
+   scaleInfoVector.resize( nfull );
+   
+   // helper variables
+   sim3Accum    first, last, pose, correction, step, previous;
+   matrix3Accum axisaxis, R;
+   vector3Accum axis;
+   Accum        angle;
+   for( int k = nsparse-1; 0 < k; k-- )
+   {
+      int start = sparseIndex[k-1];
+      int end   = sparseIndex[k];
+      absVector.touch( k-1, k );
+      relVector.touch( k, k );
+      Accum tra   = traInfoVector.get( k );
+      Accum rot   = rotInfoVector.get( k );
+      Accum scale = scaleInfoVector.get( k );
+      
+      // a relative pose that was not merged
+      if( end == start+1 )
+      {
+	sim3Store rel = relVector[k];
+	absVector.touch( end, end );
+	relVector.touch( end, end );
+	absVector[end] = absVector[k];
+	relVector[end] = rel;
+	traInfoVector.set(   end, tra );
+	rotInfoVector.set(   end, rot );
+	scaleInfoVector.set( end, scale );
+	continue;
+      }
       
+      // the original poses of the run from its kept start pose, and their summed weights
+      first = absVector[k-1].template cast<Accum>();
+      last  = absVector[k].template cast<Accum>();
+      pose  = first;
+      Accum otra = Accum(0);
+      Accum orot = Accum(0);
+      for( int n = start+1; n <= end; n++ )
+      {
+	origVector.touch( n, n );
+	pose  = pose*origVector[n].template cast<Accum>();
+	otra += infos.tra( infoIndexVector[n] );
+	orot += infos.rot( infoIndexVector[n] );
+      }
       
+      // the correction of the run in the frame of the world
+      correction = last*pose.inverse();
+      so3Log( correction.R, axis, angle );
+      axisaxis = axis*axis.transpose();
       
-	// integrate loop
-	integrateChain( start, end, true );
-		    
-	// compute loop closure update
-	lcupdate = poseVector[end*4].inverse()*closeVector[n];
-	
-	// for the two pass approach
-	if( (method == TWOPASS) || orientation_only )
-	{
-	  // no translation update during first pass
-	  lcupdate.translation() << 0.0f,0.0f,0.0f;
-	}
-
-	// interpolate loop closure update into segments
-	if( (method == ONEPASS) && !orientation_only  )
-	  normalizers = interpolateMotion( lcupdate, closeVector[n], n, start, end );
-	else
-	  normalizers = interpolateRot( lcupdate, closeVector[n], n, start, end );
-				  
-	
-	
-	// update the relative poses
-	// for one-pass approach
-	if( (method == ONEPASS) && !orientation_only  )
+      // interpolate the correction over the run
+      pose     = first;
+      previous = first;
+      Accum ctra = Accum(0);
+      Accum crot = Accum(0);
+      for( int n = start+1; n <= end; n++ )
+      {
+	Accum wtra = infos.tra( infoIndexVector[n] );
+	Accum wrot = infos.rot( infoIndexVector[n] );
+	Accum fscale = Accum(n-start)/Accum(end-start);
+	ctra += wtra;
+	crot += wrot;
+	origVector.touch( n, n );
+	pose = pose*origVector[n].template cast<Accum>();
+	if( n < end )
 	{
-	  // apply the change of basis to the segmented updates
-	  cobChain( start, end, BOTH );
-	
-	  // update both rotations and translations
-	  updateChain( start, end, BOTH );
+	  Accum ftra = (Accum(0) < otra) ? ctra/otra : fscale;
+	  Accum frot = (Accum(0) < orot) ? crot/orot : fscale;
+	  so3Exp( axis, axisaxis, Accum(cos( frot*angle )), Accum(sin( frot*angle )), R );
+	  step = sim3Accum( R, ftra*correction.t, pow( correction.s, fscale ) )*pose;
 	}
-	// do the two-pass approach
 	else
-	{
-	  
-	  // apply the change of basis to the segmented updates
-	  cobChain( start, end, ROTATION );
-	  
-	  // update the relative rotations only
-	  updateChain( start, end, ROTATION );
-			  
-	  // not for orientation-only loop closing
-	  if( !orientation_only ) 
-	  { 
-					    
-	    // correct for scale drift
-	    if( sim3_solution_space & ~ignore_sim3_solution_space )
-	    {
-	      
-	      // store scale correction factor
-	      scaleCloseFactor = scaleCloseVector(n);
-	      scaleNormalizer  = globalNormalizer * (scaleInfoVector.block( start+1, 0, (end-start), 1 ).sum() + 1.0f);
-	      
-	      // update the relative poses
-	      updateChain( start, end, SCALE );
-	      
-	      // decrease weights for poses in the loop to account for improvement in their accuracy           
-	      scaleInfoVector.block( start+1, 0, (end-start), 1 ) = scaleInfoVector.block( start+1, 0, (end-start), 1 ) * (1.0f / scaleNormalizer);
-	    }
-	    
-	    // integrate trajectory upto current time-step
-	    integrateChain( start, end, true );
-	      
-	    // compute loop closure update
-	    // only keep transaltion part
-	    lcupdate = poseVector[end*4].inverse()*closeVector[n];
-	    lcupdate.linear() << 1.0f,0.0f,0.0f,
-				 0.0f,1.0f,0.0f,
-				 0.0f,0.0f,1.0f;
-	  
-	    // interpolate loop closure update into segments
-	    normalizers = normalizers + interpolateTra( lcupdate, closeVector[n], n, start, end );
-	    
-	    // apply the change of basis to the translation updates
-	    cobChain( start, end, TRANSLATION );
-	  
-	    // update the relative poses
-	    updateChain( start, end, TRANSLATION );
-	  }
-	}
-
-	
-	
-	// integrate trajectory upto current time-step
-	// orthonormalization required due to numerical rounding errors
-	integrateChainNormalized( start, end, doNormalize == 100 );
-	doNormalize++;  
-	if( doNormalize == 101 )
-	    doNormalize = 0;
-	
-	
-	
-	
-	// decrease weights for poses in the loop to account for improvement in their accuracy  
-	rotInfoVector.block( start+1, 0, (end-start), 1 ) = rotInfoVector.block( start+1, 0, (end-start), 1 ) * normalizers[1];
-	if( !orientation_only ) 
-	  traInfoVector.block( start+1, 0, (end-start), 1 ) = traInfoVector.block( start+1, 0, (end-start), 1 ) * normalizers[0];
-	
-	// keep track of where we are
-	prev_end = end; 
+	  step = last;
+	absVector.touch( n, n );
+	relVector.touch( n, n );
+	absVector[n] = step.template cast<Storage>();
+	relVector[n] = (previous.inverse()*step).template cast<Storage>();
+	previous     = step;
 	
+	// the weights of the run decreased by the same factors as its merged weight
+	traInfoVector.set(   n, (Accum(0) < otra) ? wtra*(tra/otra) : tra/Accum(end-start) );
+	rotInfoVector.set(   n, (Accum(0) < orot) ? wrot*(rot/orot) : rot/Accum(end-start) );
+	scaleInfoVector.set( n, scale/Accum(end-start) );
       }
    }
    
-   // integrate trajectory upto final time-step
-   integrateChain( prev_end, size()-1, false );
+   // the loop closures refer to the original poses
+   for( int m = 0; m < nclosures; m++ )
+   {
+      startVector[m] = sparseIndex[startVector[m]];
+      endVector[m]   = sparseIndex[endVector[m]];
+   }
+   integrated = (integrated == nsparse-1) ? nfull-1 : sparseIndex[integrated];
+   prevEnd    = sparseIndex[prevEnd];
+   naposes    = nfull;
+   nposes     = nfull-1;
+   sparseIndex.clear();
+}
+
+
+
+//
+// start a new chain at the first absolute pose
+//
+template<typename Storage, typename Accum>
+void poseChain<Storage,Accum>::startChain( const sim3Store &aorigin )
+{
+   absVector.assign(   1, aorigin );
+   relVector.assign(   1, sim3Store::Identity() );
+   origVector.assign(  1, se3Store::Identity() );
+   closeVector.clear();
+   startVector.clear();
+   endVector.clear();
+   sparseIndex.clear();
+   traInfoVector.clear();
+   rotInfoVector.clear();
+   scaleInfoVector.clear();
+   traInfoVector.resize( 1 );
+   rotInfoVector.resize( 1 );
+   scaleInfoVector.resize( 1 );
+   infos.clear();
+   infoIndexVector.assign( 1, -1 );
+   traCloseInfoVector.clear();
+   rotCloseInfoVector.clear();
+   infoCloseIndexVector.clear();
+   
+   naposes     = 1;
+   nposes      = 0;
+   nclosures   = 0;
+   nprocessed  = 0;
+   integrated  = 0;
+   prevEnd     = 0;
+   doNormalize = 0;
+}
+
+
+
+//
+// append a relative pose to the chain and integrate it
+//
+template<typename Storage, typename Accum>
+int poseChain<Storage,Accum>::addRelativePose( const se3Store &apose, const Eigen::Matrix<float,6,6> &ainfo )
+{
+   // a chain without poses starts at identity
+   if( naposes == 0 )
+     startChain( sim3Store::Identity() );
+   allocationCheck check( steady );
+   int n = naposes;
+   
+   // store the pose and a copy of the original
+   origVector.push_back( apose );
+   relVector.push_back( sim3Store( apose ) );
+   absVector.push_back( sim3Store::Identity() );
    
+   // store the mean variance and the original information values
+   int info = internInfo( ainfo );
+   traInfoVector.resize( n+1 );
+   rotInfoVector.resize( n+1 );
+   scaleInfoVector.resize( n+1 );
+   traInfoVector.set( n, infos.tra( info ) );
+   rotInfoVector.set( n, infos.rot( info ) );
+   scaleInfoVector.set( n, 1.0f );
+   infoIndexVector.push_back( info );
+   
+   // another relative pose
+   naposes++;
+   nposes++;
+   
+   // integrate when the chain before it is up-to-date
+   if( integrated == n-1 )
+   {
+     absVector[n] = (absVector[n-1].template cast<Accum>()*relVector[n].template cast<Accum>()).template cast<Storage>();
+     integrated   = n;
+   }
+   return n;
+}
+
+
+
+//
+// append a loop closure to the chain and process it
+//
+template<typename Storage, typename Accum>
+int poseChain<Storage,Accum>::addLoopClosure( const int astart, const int aend, const se3Store &apose, const Eigen::Matrix<float,6,6> &ainfo, const Storage ascale )
+{
+   int   m = nclosures;
+   allocationCheck check( steady );
+   
+   // loop closures have to be between existing poses
+   if( (astart < 0) || (aend < 0) || (naposes <= astart) || (naposes <= aend) || (astart == aend) )
+   {
+     cerr << "Loop closure from " << astart << " to " << aend << " is not between existing poses" << endl;
+     return naposes;
+   }
+   
+   // store the loop closure from the earlier to the later pose
+   if( aend < astart )
+   {
+     closeVector.push_back( sim3Store( apose.inverse(), ascale ) );
+     startVector.push_back( aend );
+     endVector.push_back( astart );
+   }
+   else
+   {
+     closeVector.push_back( sim3Store( apose, ascale ) );
+     startVector.push_back( astart );
+     endVector.push_back( aend );
+   }
+   
+   // store the mean variance and the original information values
+   int info = internInfo( ainfo );
+   traCloseInfoVector.push_back( infos.tra( info ) );
+   rotCloseInfoVector.push_back( infos.rot( info ) );
+   infoCloseIndexVector.push_back( info );
+   nclosures++;
+   
+   // process all pending loop closures
+   int first = naposes;
+   for( ; nprocessed < nclosures; nprocessed++ )
+     if( processClosure( nprocessed ) )
+       first = min( first, startVector[nprocessed]+1 );
+   
+   // the chain after the loop follows its last pose
+   if( integrated < naposes-1 )
+   {
+     first = min( first, integrated+1 );
+     integrateChain( integrated, naposes-1, false );
+     integrated = naposes-1;
+   }
+   return first;
+}
+
+
+
+//
+// mean translation and rotation variance of an information matrix
+// the upper triangle is packed such that the weights equal those of a batch
+//
+template<typename Storage, typename Accum>
+void poseChain<Storage,Accum>::infoWeights( const Eigen::Matrix<float,6,6> &ainfo, Accum &atra, Accum &arot )
+{
+   float  packed[21];
+   double tra, rot;
+   for( int i = 0, k = 0; i < 6; i++ )
+     for( int j = i; j < 6; j++, k++ )
+       packed[k] = ainfo(i,j);
+   packedWeights( 1, 0, packed, &tra, &rot );
+   atra = tra;
+   arot = rot;
+}
+
+
+
+//
+// mean translation and rotation variances of a batch of packed information matrices
+//
+template<typename Storage, typename Accum>
+void poseChain<Storage,Accum>::infoWeights( const size_t an, const size_t astride, const float *ainfo, double *atra, double *arot )
+{
+   packedWeights( an, astride, ainfo, atra, arot );
+}
+
+
+
+//
+// the index of an information matrix in the table of distinct matrices, a new matrix is weighed at once
+//
+template<typename Storage, typename Accum>
+int poseChain<Storage,Accum>::internInfo( const Eigen::Matrix<float,6,6> &ainfo )
+{
+   float packed[21];
+   for( int i = 0, k = 0; i < 6; i++ )
+     for( int j = i; j < 6; j++, k++ )
+       packed[k] = ainfo(i,j);
+   int info = infos.insert( packed );
+   infos.weigh();
+   return info;
 }
 
 
 
 //
-// interpolate the loop closure update into segements
+// run COP-SLAM for one loop closure
 //
-Eigen::Vector3f poseChain::interpolateMotion( Eigen::Affine3f aupdate, Eigen::Affine3f adesired, const int aclosure, const int astart, const int aend )
+template<typename Storage, typename Accum>
+bool poseChain<Storage,Accum>::processClosure( const int aclosure )
+{
+   
+   int  n     = aclosure;
+   int  start = startVector[n];
+   int  end   = endVector[n];
+   bool normalize        = false;
+   bool orientation_only = false;
+   bool scale_pass       = false;
+   sim3Accum         desired;
+   sim3Accum         lcupdate;
+   vector3Accum      normalizers;
+   
+   // get start and end pose
+   cout << "Loop " << n << " from " << start << " to " << end << " (" << end-start << ")" << endl;
+   if( end < prevEnd )
+     return false;
+   cout << "Closing" << endl;
+   
+   // integrate trajectory upto current time-step
+   if( integrated < start )
+   {
+     integrateChain( integrated, start, false );      
+     integrated = start;
+   }
+   
+   // what kind (regular or orientation-only) of loop is it
+   if( !(traCloseInfoVector[n] < 4.5e9) )
+   {
+     cout << "ORIENTATION-ONLY" << endl; 
+     orientation_only = true;
+   }
+   
+   // the loop-closing scale is only used when correcting for scale drift
+   scale_pass = sim3_solution_space && !ignore_sim3_solution_space && (method == TWOPASS) && !orientation_only;
+   desired    = closeVector[n].template cast<Accum>();
+   if( !scale_pass )
+     desired.s = Accum(1);
+   
+   // orthonormalization required due to numerical rounding errors, but not for every scalar type
+   // it is done by the last sweep over the loop
+   normalize = (0 < chainScalar<Storage>::normalizeInterval) && (doNormalize == chainScalar<Storage>::normalizeInterval);
+   doNormalize++;  
+   if( doNormalize == chainScalar<Storage>::normalizeInterval+1 )
+       doNormalize = 0;
+ 
+ 
+ 
+   // integrate loop
+   integrateChain( start, end, true );
+	       
+   // compute loop closure update
+   lcupdate         = absVector[end].template cast<Accum>().inverse()*desired;
+   scaleCloseFactor = lcupdate.s;
+   
+   // for the two pass approach
+   if( (method == TWOPASS) || orientation_only )
+   {
+     // no translation update during first pass
+     lcupdate.t << 0.0f,0.0f,0.0f;
+   }
+
+
+   
+   // update the relative poses and integrate the trajectory upto current time-step
+   // for one-pass approach
+   if( (method == ONEPASS) && !orientation_only  )
+   {
+     // update both rotations and translations
+     normalizers = closeMotion( lcupdate, desired, n, start, end, normalize );
+   }
+   // do the two-pass approach
+   else
+   {
+     
+     // scale correction factor is the remaining scale of the loop closure update
+     if( scale_pass )
+       scaleNormalizer = globalNormalizer * (scaleInfoVector.sum( start+1, end ) + 1.0f);
+     
+     // update the relative rotations only, and correct for scale drift
+     // the loop is integrated from identity when the translations still need an update
+     normalizers = closeRotation( lcupdate, desired, n, start, end, scale_pass, !orientation_only, orientation_only && normalize );
+     
+     // decrease weights for poses in the loop to account for improvement in their accuracy           
+     if( scale_pass )
+       scaleInfoVector.multiply( start+1, end, 1.0f / scaleNormalizer );
+		     
+     // not for orientation-only loop closing
+     if( !orientation_only ) 
+     { 
+	 
+       // compute loop closure update
+       // only keep transaltion part
+       lcupdate = absVector[end].template cast<Accum>().inverse()*desired;
+       lcupdate.R << 1.0f,0.0f,0.0f,
+		     0.0f,1.0f,0.0f,
+		     0.0f,0.0f,1.0f;
+     
+       // update the relative translations
+       normalizers = normalizers + closeTranslation( lcupdate, desired, n, start, end, normalize );
+     }
+   }
+   
+   
+   
+   // decrease weights for poses in the loop to account for improvement in their accuracy  
+   rotInfoVector.multiply( start+1, end, normalizers[1] );
+   if( !orientation_only ) 
+     traInfoVector.multiply( start+1, end, normalizers[0] );
+   
+   // keep track of where we are
+   // the absolute poses after the loop are out-of-date when it ends before the last integrated pose
+   prevEnd = end; 
+   if( integrated < end )
+     integrated = end;
+   else if( end < integrated )
+   {
+     integrateChain( end, integrated, false );
+   }
+   return true;
+   
+}
+
+
+
+//
+// interpolate the loop closure update into segements and update the loop with both rotations and translations
+// the rotation of segment n is the rotation from angle*rotstep(n-1) to angle*rotstep(n) about the
+// update axis, the translation is tra*(trastep(n)-trastep(n-1)) expressed in the frame of angle*rotstep(n-1),
+// both conjugated by the desired pose, which amounts to rotating the axis and translation by it
+//
+template<typename Storage, typename Accum>
+typename poseChain<Storage,Accum>::vector3Accum poseChain<Storage,Accum>::closeMotion( const sim3Accum &aupdate, const sim3Accum &adesired, const int aclosure, const int astart, const int aend, const bool anormalize )
 {
    // helper variables
-   Eigen::AngleAxisf aa;
-   Eigen::Vector3f   tra;
-   Eigen::Vector3f   normalizers(0.0f,0.0f,0.0f);
-   Eigen::Affine3f   before;
-   Eigen::Affine3f   after;
-   Eigen::Affine3f   adesiredInv = adesired.inverse();
-   Eigen::Quaternion<float> quat;
-   float             sv, traNormalizer, rotNormalizer;
-   before = before.Identity();
-   after  = after.Identity();
+   vector3Accum normalizers(0.0f,0.0f,0.0f);
+   Accum        sv;
+   loopUpdate   loop;
    
    // convert motion to tangent space at identity
-   tra = aupdate.translation();	  
-   aa  = aupdate.rotation();
+   so3Log( aupdate.rotation(), loop.axis, loop.angle );
+   
+   // express axis and translation in the frame of the desired pose
+   loop.desired    = adesired;
+   loop.axis       = adesired.R*loop.axis;
+   loop.tra        = adesired.s*(adesired.R*aupdate.t);
+   loop.axisaxis   = loop.axis*loop.axis.transpose();
+   loop.axistra    = loop.axis.cross( loop.tra );
+   loop.axisdottra = loop.axis.dot( loop.tra );
+   loop.start      = astart;
+   loop.scale      = false;
           
    // get normalizer for weights
-   sv             = traInfoVector.block( astart+1, 0, (aend-astart)-1, 1 ).sum(); 
-   normalizers[0] = ( 1.0f / ( 1.0f + (sv/traCloseInfoVector(aclosure)) ) );
-   traNormalizer  = globalNormalizer * (sv + traCloseInfoVector(aclosure));
+   sv                 = traInfoVector.sum( astart+1, aend-1 );
+   normalizers[0]     = ( 1.0f / ( 1.0f + (sv/traCloseInfoVector[aclosure]) ) );
+   loop.traNormalizer = globalNormalizer * (sv + traCloseInfoVector[aclosure]);
    
    // compute normalizer and error propagation
-   sv             = rotInfoVector.block( astart+1, 0, (aend-astart)-1, 1 ).sum();
-   normalizers[1] = ( 1.0f / ( 1.0f + (sv/rotCloseInfoVector(aclosure)) ) );  
-   rotNormalizer  = globalNormalizer * (sv + rotCloseInfoVector(aclosure));
-   
-   // compute updates
-   int start     = (astart+1)*4; 
-   int end       = aend*4;
-   int nn        = (astart+1);
-   float trastep = 0.0f;
-   float rotstep = 0.0f;
-   float stepsize;
-   for( int n = start; n <= end; n = n+4 )
-   {
-      // compute absolute update
-      before  = Eigen::Translation3f(tra*trastep) * Eigen::AngleAxisf(aa.angle()*rotstep, aa.axis()); 
-      
-      // goto next pose
-      trastep = trastep + (traInfoVector(nn)/traNormalizer);
-      rotstep = rotstep + (rotInfoVector(nn)/rotNormalizer);      
-      nn++;
-      
-      // compute absolute update
-      after   = Eigen::Translation3f(tra*trastep) * Eigen::AngleAxisf(aa.angle()*rotstep, aa.axis()); 
-      
-      // compute relative motion
-      poseVector[n+3] = adesired*((before.inverse()*after)*adesiredInv);
-   }        
+   sv                 = rotInfoVector.sum( astart+1, aend-1 );
+   normalizers[1]     = ( 1.0f / ( 1.0f + (sv/rotCloseInfoVector[aclosure]) ) );  
+   loop.rotNormalizer = globalNormalizer * (sv + rotCloseInfoVector[aclosure]);
+   
+   // update and integrate
+   traInfoVector.flush( astart+1, aend );
+   rotInfoVector.flush( astart+1, aend );
+   sweepChain( BOTH, loop, astart, aend, false, anormalize );
       
    // return the normalizer for later use
    return normalizers;      
@@ -255,275 +734,397 @@ Eigen::Vector3f poseChain::interpolateMotion( Eigen::Affine3f aupdate, Eigen::Af
 
 
 //
-// interpolate the loop closure update into segements
+// interpolate the loop closure update into segements and update the relative rotations of the loop
+// the rotation of segment n is exp(axis, angle*w(n)/sum(w))
 //
-Eigen::Vector3f poseChain::interpolateTra( Eigen::Affine3f aupdate, Eigen::Affine3f adesired, const int aclosure, const int astart, const int aend )
+template<typename Storage, typename Accum>
+typename poseChain<Storage,Accum>::vector3Accum poseChain<Storage,Accum>::closeRotation( const sim3Accum &aupdate, const sim3Accum &adesired, const int aclosure, const int astart, const int aend, const bool ascale, const bool aidentity, const bool anormalize )
 {
    // helper variables
-   Eigen::Vector3f tra;
-   Eigen::Vector3f normalizers(0.0f,0.0f,0.0f);
-   Eigen::Vector3f before;
-   Eigen::Vector3f after;
-   Eigen::Affine3f motion;
-   Eigen::Affine3f adesiredInv = adesired.inverse();
-   float           traNormalizer, sv;
-   
-   // get translation
-   tra = aupdate.translation();	  
-      
-   // get normalizer for weights   
-   sv             = traInfoVector.block( astart+1, 0, (aend-astart), 1 ).sum();   
-   normalizers[0] = ( 1.0f / ( 1.0f + (sv/traCloseInfoVector(aclosure)) ) );
-   traNormalizer  = globalNormalizer * (sv + traCloseInfoVector(aclosure));
-   
-   // compute updates
-   int start     = (astart+1)*4; 
-   int end       = aend*4;
-   int nn        = (astart+1);
-   for( int n = start; n <= end; n = n+4 )
-   {
-
-      // compute relative translation
-      motion          = Eigen::Translation3f( tra*(traInfoVector(nn,0)/traNormalizer) );
-      poseVector[n+3] = adesired*motion*adesiredInv;
-      nn++;
-   }        
+   vector3Accum normalizers(0.0f,0.0f,0.0f);
+   Accum        sv;
+   Accum        scaleCorrection;
+   loopUpdate   loop;
+   
+   // convert rotation to tangent space at identity
+   // and express the axis in the frame of the desired pose
+   so3Log( aupdate.rotation(), loop.axis, loop.angle );
+   loop.desired  = adesired;
+   loop.axis     = adesired.R*loop.axis;
+   loop.axisaxis = loop.axis*loop.axis.transpose();
+   loop.start    = astart;
+   loop.scale    = ascale;
+   
+   // get normalizer for weights  
+   sv                 = rotInfoVector.sum( astart+1, aend );
+   normalizers[1]     = ( 1.0f / ( 1.0f + (sv/rotCloseInfoVector[aclosure]) ) );
+   loop.rotNormalizer = globalNormalizer * (sv + rotCloseInfoVector[aclosure]);
+   
+   // update and integrate
+   rotInfoVector.flush( astart+1, aend );
+   if( ascale )
+     scaleInfoVector.flush( astart+1, aend );
+   scaleCorrection = sweepChain( ROTATION, loop, astart, aend, aidentity, anormalize );
+   if( ascale )
+     cout << "Loop-closure final scale correction: " << scaleCorrection << endl;
       
    // return the normalizer for later use
-   return normalizers;      
+   return normalizers;
+      
 }
 
 
 
 //
-// interpolate the loop closure update into segements
+// interpolate the loop closure update into segements and update the relative translations of the loop
+// the translation of segment n is tra*w(n)/sum(w)
 //
-Eigen::Vector3f poseChain::interpolateRot( Eigen::Affine3f aupdate, Eigen::Affine3f adesired, const int aclosure, const int astart, const int aend )
+template<typename Storage, typename Accum>
+typename poseChain<Storage,Accum>::vector3Accum poseChain<Storage,Accum>::closeTranslation( const sim3Accum &aupdate, const sim3Accum &adesired, const int aclosure, const int astart, const int aend, const bool anormalize )
 {
    // helper variables
-   Eigen::AngleAxisf aa;
-   Eigen::Vector3f   normalizers(0.0f,0.0f,0.0f);
-   Eigen::Affine3f   before;
-   Eigen::Affine3f   after;
-   Eigen::Affine3f   motion;
-   Eigen::Affine3f   adesiredInv = adesired.inverse();
-   float             rotNormalizer, sv;
+   vector3Accum normalizers(0.0f,0.0f,0.0f);
+   Accum        sv;
+   loopUpdate   loop;
    
-   // convert rotation to tangent space at identity
-   aa = aupdate.rotation();
-   float angle = aa.angle();
-   if( M_PI < angle )
-     angle = angle - 2*M_PI;
+   // get translation expressed in the frame of the desired pose
+   loop.desired = adesired;
+   loop.tra     = adesired.s*(adesired.R*aupdate.t);	  
+   loop.start   = astart;
+   loop.scale   = false;
+      
+   // get normalizer for weights   
+   sv                 = traInfoVector.sum( astart+1, aend );
+   normalizers[0]     = ( 1.0f / ( 1.0f + (sv/traCloseInfoVector[aclosure]) ) );
+   loop.traNormalizer = globalNormalizer * (sv + traCloseInfoVector[aclosure]);
    
-   // get normalizer for weights  
-   sv             = rotInfoVector.block( astart+1, 0, (aend-astart), 1 ).sum();
-   normalizers[1] = ( 1.0f / ( 1.0f + (sv/rotCloseInfoVector(aclosure)) ) );
-   rotNormalizer  = globalNormalizer * (sv + rotCloseInfoVector(aclosure));
-   
-   // compute updates
-   int start     = (astart+1)*4; 
-   int end       = aend*4;
-   int nn        = (astart+1);
-   for( int n = start; n <= end; n = n+4 )
-   {
-
-      // compute relative rotation
-      motion.linear() = Eigen::AngleAxisf( angle*(rotInfoVector(nn,0)/rotNormalizer), aa.axis() ).toRotationMatrix();
-      poseVector[n+3].linear() = adesired.linear()*motion.linear()*adesiredInv.linear();      
-      nn++;     
-   }        
+   // update and integrate
+   traInfoVector.flush( astart+1, aend );
+   sweepChain( TRANSLATION, loop, astart, aend, false, anormalize );
       
    // return the normalizer for later use
-   return normalizers;
-      
+   return normalizers;      
 }
 
 
 
 //
-// compute absolute poses from relative poses
+// sweep over the relative poses of a loop
+// long loops are split in chunks: each chunk is updated in parallel while the product of its
+// relative poses is computed, after which the chunks are integrated as in integrateChain
 //
-void poseChain::integrateChain( const int astart, const int aend, const bool aidentity )
+template<typename Storage, typename Accum>
+Accum poseChain<Storage,Accum>::sweepChain( const int amethod, const loopUpdate &aloop, const int astart, const int aend, const bool aidentity, const bool anormalize )
 {
-    
+   
+   // the sweep over one range of poses
+   auto sweep = [&]( const int afirst, const int alast, sim3Accum &apose, const bool astore ) -> Accum
+   {
+      if( amethod == BOTH )
+	return sweepMotion( aloop, afirst, alast, apose, astore, anormalize );
+      else if( amethod == ROTATION )
+	return sweepRotation( aloop, afirst, alast, apose, astore, anormalize );
+      else
+	return sweepTranslation( aloop, afirst, alast, apose, astore, anormalize );
+   };
+   
    // first abolute pose is identity
-   Eigen::Affine3f temp;
+   sim3Accum pose;
    if( aidentity )
-   {
-     temp                 = poseVector[astart*4];
-     poseVector[astart*4] = Eigen::Translation<float,3>(0.0f,0.0f,0.0f) * Eigen::Quaternion<float>(1.0f,0.0f,0.0f,0.0f);
-   }
+     pose = sim3Accum::Identity();
+   else
+     pose = absVector[astart].template cast<Accum>();
    
    // go through the relative poses
-   int start = (astart+1)*4;
-   int end   = aend*4;     
-   EIGEN_ASM_COMMENT("begin");
-   for( int n = start; n <= end; n = n+4 )
-   {
-     
-      // and integrate the absolute pose chain
-      poseVector[n] = poseVector[n-4]*poseVector[n+1];
-      
-   }
-   EIGEN_ASM_COMMENT("end");
-      
-   // set back
-   if( aidentity )
+   int start   = astart+1;
+   int end     = aend;     
+   int nchunks = pool.size();
+   if( (nchunks < 2) || (end-start+1 < parallelThreshold) )
+     return sweep( start, end, pose, true );
+   
+   // chunk k holds the poses from first[k] upto first[k+1]
+   vector<int>       &first       = chunkFirst;
+   vector<sim3Accum> &prefix      = chunkPrefix;
+   vector<Accum>     &corrections = chunkCorrections;
+   first.resize( nchunks+1 );
+   prefix.resize( nchunks );
+   corrections.resize( nchunks );
+   for( int k = 0; k <= nchunks; k++ )
+     first[k] = start + (int)(((long)k*(end-start+1))/nchunks);
+   
+   // update the chunks and compute their products, the product of the last chunk is not needed
+   pool.run( nchunks, [&]( int k )
    {
-     poseVector[astart*4] = temp;
-   }
-
+      sim3Accum product = sim3Accum::Identity();
+      corrections[k] = sweep( first[k], first[k+1]-1, product, false );
+      if( k+1 < nchunks )
+	prefix[k+1] = product;
+   });
+   
+   // integrate the updated chunks
+   prefix[0] = pose;
+   integrateChunks( first, prefix );
+   
+   Accum correction = Accum(1);
+   for( int k = 0; k < nchunks; k++ )
+     correction = correction*corrections[k];
+   return correction;
 }
 
 
 
 //
-// compute absolute poses from relative poses
+// update the relative poses with the interpolated motions and integrate them
+// the change of basis of update u with absolute pose a is inverse(a)*u*a
 //
-void poseChain::integrateChainNormalized( const int astart, const int aend, const bool normalize )
+template<typename Storage, typename Accum>
+Accum poseChain<Storage,Accum>::sweepMotion( const loopUpdate &aloop, const int afirst, const int alast, sim3Accum &apose, const bool astore, const bool anormalize )
 {
-    
-   // go through the relative poses
-   int start = (astart+1)*4;
-   int end   = aend*4;     
-   EIGEN_ASM_COMMENT("begin");
-   if( normalize )
+   // helper variables
+   vector3Accum   tmp;
+   Accum          cstep, sstep;
+   Accum          trabefore;
+   sim3Accum      abs;
+   sim3Accum      rel;
+   se3Accum       motion;
+   
+   // the flushed weights
+   const Accum *traWeights = traInfoVector.leaves();
+   const Accum *rotWeights = rotInfoVector.leaves();
+   
+   // the interpolation steps before the first pose
+   Accum trastep = 0.0f;
+   Accum rotstep = 0.0f;
+   if( afirst > aloop.start+1 )
    {
-      // normalize relative poses
-      for( int n = start; n <= end; n = n+4 )
-      {
-	  // normalize relative rotations
-	  poseVector[n+1].linear() = poseVector[n+1].rotation();
-      }            
+      trastep = traInfoVector.sum( aloop.start+1, afirst-1 )/aloop.traNormalizer;
+      rotstep = rotInfoVector.sum( aloop.start+1, afirst-1 )/aloop.rotNormalizer;
    }
+   so3Walk<Accum> walk;
+   if( afirst > aloop.start+1 )
+     walk = so3Walk<Accum>( aloop.angle*rotstep );
    
-   // integrate
-   for( int n = start; n <= end; n = n+4 )
+   for( int n = afirst; n <= alast; n++ )
    {
+      // the translation of the inverse of the absolute update before this pose
+      motion.t  = so3Rotate( aloop.axis, aloop.tra, aloop.axistra, aloop.axisdottra, walk.c, -walk.s );
+      trabefore = trastep;
+      
+      // goto next pose
+      trastep = trastep + (traWeights[n]/aloop.traNormalizer);
+      rotstep = rotstep + (rotWeights[n]/aloop.rotNormalizer);      
+      
+      // relative rotation from the absolute update before to the one after this pose
+      walk.stepTo( aloop.angle*rotstep, cstep, sstep );
+      so3Exp( aloop.axis, aloop.axisaxis, cstep, sstep, motion.R );
+      
+      // compute relative motion
+      motion.t = (trastep-trabefore)*motion.t - motion.R*aloop.desired.t + aloop.desired.t;
+      
+      // apply the change of basis
+      abs              = absVector[n].template cast<Accum>();
+      tmp.noalias()    = motion.R*abs.t;
+      tmp             += motion.t - abs.t;
+      motion.R         = rotationChangeOfBasis( abs.R, motion.R );
+      motion.t.noalias() = (Accum(1)/abs.s)*(abs.R.transpose()*tmp);
+      
+      // update the relative pose
+      rel = relVector[n].template cast<Accum>()*motion;
+      if( anormalize )
+	rel.normalize();
+      relVector[n] = rel.template cast<Storage>();
+      
       // and integrate the absolute pose chain
-      poseVector[n] = poseVector[n-4]*poseVector[n+1];      
+      apose = apose*relVector[n].template cast<Accum>();
+      if( astore )
+	absVector[n] = apose.template cast<Storage>();
    }
-   
-   EIGEN_ASM_COMMENT("end");
-       	
+   return Accum(1);
 }
 
 
 
 //
-// apply the change of basis to the updates
+// update the relative rotations with the interpolated rotations and integrate them
+// the rotations are computed per tile of poses, batched over the poses when possible
 //
-void poseChain::cobChain( const int astart, const int aend, const int amethod )
+template<typename Storage, typename Accum>
+Accum poseChain<Storage,Accum>::sweepRotation( const loopUpdate &aloop, const int afirst, const int alast, sim3Accum &apose, const bool astore, const bool anormalize )
 {
-  
-   // go through the relative poses
-   int start = (astart+1)*4; 
-   int end   = aend*4;  
-   Eigen::Affine3f tmp;
+   // helper variables
+   se3Store     tile[SWEEP_TILE];
+   matrix3Accum upd;
+   sim3Accum    rel;
+   Accum     factor;
+   Accum     scaleCorrection = 1.0f;
+   int       count;
    
-   EIGEN_ASM_COMMENT("begin");
-   if( (amethod == BOTH) )
+   for( int first = afirst; first <= alast; first += SWEEP_TILE )
    {
-     for( int n = start; n <= end; n = n+4 )
-     {
-
-         // aply the change of basis for each update
-	 poseVector[n+3]          = (poseVector[n].inverse()*poseVector[n+3])*poseVector[n];
-
-     }
+      // the interpolated rotations of the tile
+      count = min( SWEEP_TILE, alast-first+1 );
+      so3ExpSteps( aloop.axis, aloop.axisaxis, aloop.angle, rotInfoVector.leaves()+first, aloop.rotNormalizer, tile, count );
+      
+      for( int i = 0; i < count; i++ )
+      {
+	  int n = first+i;
+	  
+	  // apply the change of basis and update the relative rotation
+	  upd   = tile[i].R.template cast<Accum>();
+	  rel   = relVector[n].template cast<Accum>();
+	  rel.R = rel.R*rotationChangeOfBasis<Accum>( absVector[n].R.template cast<Accum>(), upd );
+	  
+	  // pre-multiply the relative pose with its share of the scale correction
+	  if( aloop.scale )
+	  {
+	    factor          = pow( scaleCloseFactor, scaleInfoVector.leaves()[n]/scaleNormalizer );	
+	    scaleCorrection = scaleCorrection*factor;
+	    rel.t           = factor*rel.t;
+	    rel.s           = factor*rel.s;
+	  }
+	  
+	  if( anormalize )
+	    rel.normalize();
+	  relVector[n] = rel.template cast<Storage>();
+	  
+	  // and integrate the absolute pose chain
+	  apose = apose*relVector[n].template cast<Accum>();
+	  if( astore )
+	    absVector[n] = apose.template cast<Storage>();
+      }
    }
-   else if( amethod == ROTATION )
-   {
-     for( int n = start; n <= end; n = n+4 )
-     {       
+   return scaleCorrection;
+}
+
 
-         // apply the change of basis for each update
-         tmp                      = poseVector[n].inverse();
-         poseVector[n+3].linear() = tmp.linear() * poseVector[n+3].linear() * poseVector[n].linear();
 
-     }  
-   }   
-   else if( amethod == TRANSLATION )
+//
+// update the relative translations with the interpolated translations and integrate them
+//
+template<typename Storage, typename Accum>
+Accum poseChain<Storage,Accum>::sweepTranslation( const loopUpdate &aloop, const int afirst, const int alast, sim3Accum &apose, const bool astore, const bool anormalize )
+{
+   // helper variables
+   vector3Accum tra;
+   sim3Accum    abs;
+   sim3Accum    rel;
+   const Accum *traWeights = traInfoVector.leaves();
+   
+   for( int n = afirst; n <= alast; n++ )
    {
-     for( int n = start; n <= end; n = n+4 )
-     {
-         // aply the change of basis for each update
-         tmp = poseVector[n];
-         tmp.translation() << 0.0f,0.0f,0.0f;
-         tmp = tmp.inverse();	 
-         poseVector[n+3].translation() = tmp.linear() * poseVector[n+3].translation();
-	  
-     }  
+      // relative translation in the frame of the absolute pose
+      abs   = absVector[n].template cast<Accum>();
+      tra   = aloop.tra*(traWeights[n]/aloop.traNormalizer);
+      rel   = relVector[n].template cast<Accum>();
+      rel.t = rel.t + (Accum(1)/abs.s)*(abs.R.transpose()*tra);
+      
+      if( anormalize )
+	rel.normalize();
+      relVector[n] = rel.template cast<Storage>();
+      
+      // and integrate the absolute pose chain
+      apose = apose*relVector[n].template cast<Accum>();
+      if( astore )
+	absVector[n] = apose.template cast<Storage>();
    }
-   EIGEN_ASM_COMMENT("end");  
+   return Accum(1);
 }
 
 
 
 //
-// update the relative poses
+// compute absolute poses from relative poses
+// the running absolute pose is kept in the accumulation type
+// long ranges are integrated as a parallel prefix product over chunks of the range:
+// the product of each chunk is computed in parallel (up-sweep), the products are
+// scanned serially, and each chunk is integrated from its prefix in parallel (down-sweep)
 //
-void poseChain::updateChain( const int astart, const int aend, const int amethod )
+template<typename Storage, typename Accum>
+void poseChain<Storage,Accum>::integrateChain( const int astart, const int aend, const bool aidentity )
 {
-  
+    
+   // page in the range when the chain is disk-backed, the sweeps over a loop follow its integration
+   absVector.touch( astart, aend );
+   relVector.touch( astart, aend );
+   
+   // first abolute pose is identity
+   sim3Accum pose;
+   if( aidentity )
+     pose = sim3Accum::Identity();
+   else
+     pose = absVector[astart].template cast<Accum>();
+   
    // go through the relative poses
-   int start             = (astart+1)*4; 
-   int end               = aend*4;
-   int nn                = 0;
-   float scaleCorrection = 1.0f;
-   Eigen::Affine3f tmp;
-   EIGEN_ASM_COMMENT("begin");
-   if( amethod == BOTH )
+   int start   = astart+1;
+   int end     = aend;     
+   int nchunks = pool.size();
+   if( (nchunks < 2) || (end-start+1 < parallelThreshold) )
    {
-      for( int n = start; n <= end; n = n+4 )
+      EIGEN_ASM_COMMENT("begin");
+      for( int n = start; n <= end; n++ )
       {
-
-	  // update the relative poses
-	  tmp             = poseVector[n+1]*poseVector[n+3];
-	  poseVector[n+1] = tmp;
+	
+	  // and integrate the absolute pose chain
+	  pose         = pose*relVector[n].template cast<Accum>();
+	  absVector[n] = pose.template cast<Storage>();
 	  
       }
+      EIGEN_ASM_COMMENT("end");
+      return;
    }
-   else if( amethod == ROTATION )
+   
+   // chunk k holds the poses from first[k] upto first[k+1]
+   vector<int>       &first  = chunkFirst;
+   vector<sim3Accum> &prefix = chunkPrefix;
+   first.resize( nchunks+1 );
+   prefix.resize( nchunks );
+   for( int k = 0; k <= nchunks; k++ )
+     first[k] = start + (int)(((long)k*(end-start+1))/nchunks);
+   
+   // up-sweep, the product of the last chunk is not needed
+   pool.run( nchunks-1, [&]( int k )
    {
-      for( int n = start; n <= end; n = n+4 )
-      {	
+      sim3Accum product = relVector[first[k]].template cast<Accum>();
+      for( int n = first[k]+1; n < first[k+1]; n++ )
+	product = product*relVector[n].template cast<Accum>();
+      prefix[k+1] = product;
+   });
+   
+   // scan and down-sweep
+   prefix[0] = pose;
+   integrateChunks( first, prefix );
 
-	  // update the relative rotations
-	  poseVector[n+1].linear() = poseVector[n+1].linear() * poseVector[n+3].linear();
+}
 
-      }
-   }
-   else if( amethod == TRANSLATION )
-   {
-      for( int n = start; n <= end; n = n+4 )
-      {
 
-	  // update the relative translations
-	  poseVector[n+1].translation() = poseVector[n+1].translation() + poseVector[n+3].translation();
 
-      }
-   }
-   else if( amethod == SCALE )
-   {            
-          
-      for( int n = start; n <= end; n = n+4 )
+//
+// scan of the chunk products followed by the down-sweep
+//
+template<typename Storage, typename Accum>
+void poseChain<Storage,Accum>::integrateChunks( const vector<int> &afirst, vector<sim3Accum> &aprefix )
+{
+   int nchunks = aprefix.size();
+   
+   // scan of the chunk products
+   for( int k = 1; k < nchunks; k++ )
+     aprefix[k] = aprefix[k-1]*aprefix[k];
+   
+   // down-sweep
+   pool.run( nchunks, [&]( int k )
+   {
+      sim3Accum pose = aprefix[k];
+      for( int n = afirst[k]; n < afirst[k+1]; n++ )
       {
-	
-	  // update the relative translations
-	  tmp                = poseVector[n+1];
-	  scaleCorrection    = scaleCorrection*pow( scaleCloseFactor, scaleInfoVector(astart+1+nn)/scaleNormalizer );	
-	  scaleVector(n/4,0) = scaleCorrection;
-	  tmp.translation()  = scaleCorrection*poseVector[n+1].translation();
-	  poseVector[n+1]    = tmp;	  
-	  nn++;
-	  
-      }            
-      cout << "Loop-closure final scale correction: " << scaleCorrection << endl;
-      
-      
-   } 
-   EIGEN_ASM_COMMENT("end"); 
+	  pose         = pose*relVector[n].template cast<Accum>();
+	  absVector[n] = pose.template cast<Storage>();
+      }
+   });
 }
 
 
+
+// the supported combinations of storage and accumulation types
+template class poseChain<float,float>;
+template class poseChain<double,double>;
+template class poseChain<float,double>;
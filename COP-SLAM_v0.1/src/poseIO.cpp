@@ -8,7 +8,8 @@
 //
 // constructor
 //
-poseIO::poseIO( void ):poseChain()
+template<typename Storage, typename Accum>
+poseIO<Storage,Accum>::poseIO( void ):poseChain<Storage,Accum>()
 {
     nposes    = 0;       // default zero relative poses
     naposes   = 0;       // defualr zero absolute poses
@@ -18,13 +19,15 @@ poseIO::poseIO( void ):poseChain()
     rt3_solution_space  = 0;
     sim3_solution_space = 0;        // default SE(3) is the solution space and not SIM(3)
     ignore_sim3_solution_space = 0; // do not ignore scale in solutions space
+    fastLoad = false;               // default read all vertices
 }
 
 
 //
 // print number of poses to output
 //
-void poseIO::printNPoses( ostream &aOutput ) const
+template<typename Storage, typename Accum>
+void poseIO<Storage,Accum>::printNPoses( ostream &aOutput ) const
 {
     aOutput << "Number of relative poses: " << nposes << endl; 
 }
@@ -33,7 +36,8 @@ void poseIO::printNPoses( ostream &aOutput ) const
 //
 // print number of absolute poses to output
 //
-void poseIO::printNAPoses( ostream &aOutput ) const
+template<typename Storage, typename Accum>
+void poseIO<Storage,Accum>::printNAPoses( ostream &aOutput ) const
 {
     aOutput << "Number of absolute poses: " << naposes << endl; 
 }
@@ -42,7 +46,8 @@ void poseIO::printNAPoses( ostream &aOutput ) const
 //
 // print number of loop closures to output
 //
-void poseIO::printNClosures( ostream &aOutput ) const
+template<typename Storage, typename Accum>
+void poseIO<Storage,Accum>::printNClosures( ostream &aOutput ) const
 {
     aOutput << "Number of loop closures: " << nclosures << endl; 
 }
@@ -51,7 +56,8 @@ void poseIO::printNClosures( ostream &aOutput ) const
 //
 // print number of poses to output
 //
-void poseIO::printIFileName( ostream &aOutput ) const
+template<typename Storage, typename Accum>
+void poseIO<Storage,Accum>::printIFileName( ostream &aOutput ) const
 {
     aOutput << "Input file name: " << iFile << endl; 
 }
@@ -60,7 +66,8 @@ void poseIO::printIFileName( ostream &aOutput ) const
 //
 // print number of poses to output
 //
-void poseIO::printOFileName( ostream &aOutput ) const
+template<typename Storage, typename Accum>
+void poseIO<Storage,Accum>::printOFileName( ostream &aOutput ) const
 {
     aOutput << "Output file name: " << oFile << endl; 
 }
@@ -69,7 +76,8 @@ void poseIO::printOFileName( ostream &aOutput ) const
 //
 // print number of poses to output
 //
-void poseIO::printMethod( ostream &aOutput ) const
+template<typename Storage, typename Accum>
+void poseIO<Storage,Accum>::printMethod( ostream &aOutput ) const
 {
   if( method == ONEPASS )
     aOutput << "Using one-pass method." << endl; 
@@ -81,7 +89,8 @@ void poseIO::printMethod( ostream &aOutput ) const
 //
 // set the file which contains the poses
 //
-void poseIO::setInputFile( string aIFile )
+template<typename Storage, typename Accum>
+void poseIO<Storage,Accum>::setInputFile( string aIFile )
 {
     iFile = aIFile;
 }
@@ -90,7 +99,8 @@ void poseIO::setInputFile( string aIFile )
 //
 // set the file to write the new poses to
 //
-void poseIO::setOutputFile( string aOFile )
+template<typename Storage, typename Accum>
+void poseIO<Storage,Accum>::setOutputFile( string aOFile )
 {
     oFile = aOFile;
 }
@@ -99,7 +109,8 @@ void poseIO::setOutputFile( string aOFile )
 //
 // set the method to be used
 //
-void poseIO::setMethod( string aMethod )
+template<typename Storage, typename Accum>
+void poseIO<Storage,Accum>::setMethod( string aMethod )
 {
     if( aMethod == "one-pass" )
       method = ONEPASS;
@@ -112,93 +123,397 @@ void poseIO::setMethod( string aMethod )
 }
 
 
+//
+// set the load mode
+//
+template<typename Storage, typename Accum>
+void poseIO<Storage,Accum>::setLoadMode( string aMode )
+{
+    fastLoad = (aMode == "fast-load");
+}
+
+
 //
 // parse the input file
+// the file is mapped into memory, a binary graph is used in place, a g2o file is split into chunks at line boundaries
+// which are parsed in parallel, one chunk per thread at a time, and appended to the chain in file order
+// the storage grows while parsing and the solution space and the consistency check follow from the counts of the lines
+// in the fast load mode only the first vertex is read, the other absolute poses follow from the relative poses
 //
-bool poseIO::parseInputFile()
+template<typename Storage, typename Accum>
+bool poseIO<Storage,Accum>::parseInputFile()
 {
-   // edge, vertex and covariance variables
-   int start_pose, end_pose;
-   float tx,ty,tz,q1,q2,q3,q4,st,sq,itx,ity,itz,iqx,iqy,iqz,scale;
-   Eigen::Matrix<float,6,6> Cov;
-   Eigen::Matrix<float,6,6> tmp;
-   
    // open the file for reading
    cout << "Opening file: " << iFile << " for reading." << endl;
-   ifstream inFile( iFile.c_str(), ios::in );
-  
+   mappedFile inFile( iFile );
+   
    
    // could not open file 
-   if( !inFile )
+   if( !inFile.good() )
    {
       cerr << "Unable to open input file: " << iFile << endl;
       return false;
    }
    
    
-   // count the number of lines (last line may not end with \n)
-   int    nlines = 0;
-   string line;
-   while ( inFile.good () )
+   // empty chain
+   clearChain();
+   
+   
+   // binary graph
+   if( binaryGraph::isBinary( inFile.data(), inFile.size() ) )
+     return parseBinary( binaryGraph( inFile.data(), inFile.size() ) );
+   
+   
+   // go through the file
+   long               nlines           = 0;
+   int                exp_naposes_se3  = 0;
+   int                exp_naposes_rt3  = 0;
+   int                exp_naposes_sim3 = 0;
+   int                vertexSpace      = 0;
+   int                edgeSpace        = 0;
+   vector<parseChunk> chunks( this->pool.size() );
+   const char        *begin            = inFile.data();
+   const char        *last             = inFile.data() + inFile.size();
+   while( begin < last )
    {
-      getline( inFile, line );
-      if ( line != "" )
+      // the next chunks, each ends after a newline or at the end of the file
+      int nchunks = 0;
+      for( ; (nchunks < (int)chunks.size()) && (begin < last); nchunks++ )
       {
-            ++nlines;
+	const char *end = begin + min( (size_t)(last-begin), (size_t)PARSE_CHUNK );
+	if( end < last )
+	{
+	  const char *newline = (const char*)memchr( end, '\n', last-end );
+	  end = (newline == NULL) ? last : newline+1;
+	}
+	chunks[nchunks].first    = begin;
+	chunks[nchunks].last     = end;
+	chunks[nchunks].fastLoad = fastLoad;
+	begin = end;
       }
-   }           
+      
+      // parse them in parallel
+      this->pool.run( nchunks, [&]( int k )
+      {
+	parseLines( chunks[k] );
+      } );
+      
+      // append them in file order
+      for( int k = 0; k < nchunks; k++ )
+      {
+	parseChunk &chunk = chunks[k];
+	if( chunk.failed )
+	{
+	  cerr << "Unable to parse: " << chunk.failedLine << endl;
+	  return false;
+	}
+	nlines           += chunk.nlines;
+	exp_naposes_se3  += chunk.nse3;
+	exp_naposes_sim3 += chunk.nsim3;
+	exp_naposes_rt3  += chunk.nrt3;
+	vertexSpace       = vertexSpace ? vertexSpace : chunk.vertexSpace;
+	edgeSpace         = edgeSpace   ? edgeSpace   : chunk.edgeSpace;
+	
+	// store in absVector, the relative poses are initialized with identity poses
+	// in the fast load mode only the first vertex of the file is stored
+	for( int n = 0; n < (int)chunk.vertices.size(); n++ )
+	{
+	  if( fastLoad && (0 < naposes) )
+	    break;
+	  reserveChain( naposes );
+	  absVector[naposes] = vertexPose( chunk.vertices[n] );
+	  naposes++;
+	}
+	
+	// store as relative pose or loop closure, the information matrices of the chunk are added to those of the chain
+	vector<int> chainInfo( chunk.infos.size(), -1 );
+	for( int n = 0; n < (int)chunk.edges.size(); n++ )
+	{
+	  int info = chunk.infoIndex[n];
+	  if( chainInfo[info] < 0 )
+	    chainInfo[info] = infos.insert( chunk.infos.info( info ), chunk.infos.tra( info ), chunk.infos.rot( info ) );
+	  storeEdge( chunk.edges[n], chainInfo[info] );
+	}
+      }
+   }     
    cout << "Number of pose lines: " << nlines << endl;
    
    
-   // reset file   
-   inFile.clear();
-   inFile.seekg( 0, ios::beg );
+   // in the fast load mode the chain has an absolute pose per relative pose, the first one being
+   // the first vertex, if any, and the solution space is that of the first vertex or the first edge
+   if( fastLoad )
+   {
+      cout << "Fast load: only the first vertex is read" << endl;
+      for( int m = 0; m < nclosures; m++ )
+	if( (nposes < startVector[m]) || (nposes < endVector[m]) || (startVector[m] < 0) )
+	{
+	  cerr << "Loop closure from " << startVector[m] << " to " << endVector[m] << " is not between existing poses" << endl;
+	  return false;
+	}
+      reserveChain( nposes );
+      naposes = nposes+1;
+      int space = vertexSpace ? vertexSpace : edgeSpace;
+      return checkChain( (long)naposes+nposes+nclosures, (SPACE_SE3 == space)*naposes, (SPACE_SIM3 == space)*naposes, (SPACE_RT3 == space)*naposes );
+   }
    
    
-   // count the number of absolute poses
-   int exp_naposes      = 0;
-   int exp_naposes_se3  = 0;
-   int exp_naposes_rt3  = 0;
-   int exp_naposes_sim3 = 0;
-   while( inFile.good() )
+   // solution space and consistency
+   return checkChain( nlines, exp_naposes_se3, exp_naposes_sim3, exp_naposes_rt3 );
+}
+
+
+
+//
+// parse the lines of a chunk into records, the edges refer to the distinct information matrices of the chunk,
+// whose weights are computed afterwards in one batch
+// parsing stops at the first line that cannot be parsed
+//
+template<typename Storage, typename Accum>
+void poseIO<Storage,Accum>::parseLines( parseChunk &aChunk )
+{
+   vertexRecord             vertex;
+   edgeRecord               edge;
+   string                   lastLine;
+   const char              *begin = aChunk.first;
+   const char              *last  = aChunk.last;
+   aChunk.vertices.clear();
+   aChunk.edges.clear();
+   aChunk.infos.clear();
+   aChunk.infoIndex.clear();
+   aChunk.nlines      = 0;
+   aChunk.nse3        = 0;
+   aChunk.nsim3       = 0;
+   aChunk.nrt3        = 0;
+   aChunk.vertexSpace = 0;
+   aChunk.edgeSpace   = 0;
+   aChunk.failed      = false;
+   while( begin < last )
    {
-      // find lines for edges
-      getline(inFile,line);
-      if( line.substr(0,15) == "VERTEX_SE3:QUAT" )
-      {                        
-	exp_naposes_se3++;
+      // the next line (last line may not end with \n, it is copied such that it ends with \0)
+      const char *end = (const char*)memchr( begin, '\n', last-begin );
+      if( end == NULL )
+      {
+	lastLine.assign( begin, last );
+	begin = lastLine.c_str();
+	last  = begin + lastLine.size();
+	end   = last;
+      }
+      size_t length = end-begin;
+      const char *line = begin;
+      begin = end+1;
+      if( length == 0 )
+	continue;
+      aChunk.nlines++;
+      
+      // find lines for SE(3), SIM(3) and RxT(3) vertices and edges
+      int  type = graphLine( line, length );
+      bool ok   = true;
+      if( (LINE_VERTEX_SE3 == type) || (LINE_VERTEX_RST3 == type) || (LINE_VERTEX_RT3 == type) )
+      {
+	aChunk.nse3  += (LINE_VERTEX_SE3  == type);
+	aChunk.nsim3 += (LINE_VERTEX_RST3 == type);
+	aChunk.nrt3  += (LINE_VERTEX_RT3  == type);
+	if( 0 == aChunk.vertexSpace )
+	  aChunk.vertexSpace = graphSpace( type );
+	if( !aChunk.fastLoad || aChunk.vertices.empty() )
+	{
+	  ok = scanVertex( line, end, vertex );
+	  aChunk.vertices.push_back( vertex );
+	}
       }
-      else if( line.substr(0,16) == "VERTEX_RST3:QUAT" )
-      {                        
-	exp_naposes_sim3++;
+      else if( (LINE_EDGE_SE3 == type) || (LINE_EDGE_RST3 == type) || (LINE_EDGE_RT3 == type) )
+      {
+	if( 0 == aChunk.edgeSpace )
+	  aChunk.edgeSpace = graphSpace( type );
+	ok = scanEdge( line, end, edge );
+	aChunk.edges.push_back( edge );
+	aChunk.infoIndex.push_back( aChunk.infos.insert( edge.info ) );
       }
-      else if( line.substr(0,15) == "VERTEX_RT3:QUAT" )
-      {                        
-	exp_naposes_rt3++;
+      
+      // the line is reported when the chunk is appended
+      if( !ok )
+      {
+	aChunk.failed = true;
+	aChunk.failedLine.assign( line, length );
+	return;
       }
    }
    
+   // the weights of the distinct information matrices
+   aChunk.infos.weigh();
+}
+
+
+
+//
+// load a binary graph, the records are converted in place without parsing
+//
+template<typename Storage, typename Accum>
+bool poseIO<Storage,Accum>::parseBinary( const binaryGraph &aGraph )
+{
+   if( !aGraph.good() )
+   {
+      cerr << "Unsupported binary graph file: " << iFile << endl;
+      return false;
+   }
+   
+   // all absolute poses at once
+   const vertexRecord *vertices = aGraph.vertices();
+   const edgeRecord   *edges    = aGraph.edges();
+   long                nlines   = aGraph.nvertices() + aGraph.nedges();
+   if( 0 < aGraph.nvertices() )
+     reserveChain( aGraph.nvertices()-1 );
+   for( naposes = 0; naposes < (int)aGraph.nvertices(); naposes++ )
+     absVector[naposes] = vertexPose( vertices[naposes] );
+   
+   // relative poses and loop closures in file order, with their stored weights
+   for( size_t n = 0; n < aGraph.nedges(); n++ )
+     storeEdge( edges[n], infos.insert( edges[n].info, edges[n].tra, edges[n].rot ) );
+   cout << "Number of pose records: " << nlines << endl;
+   
+   // solution space and consistency
+   return checkChain( nlines, (SPACE_SE3 == aGraph.space())*naposes, (SPACE_SIM3 == aGraph.space())*naposes, (SPACE_RT3 == aGraph.space())*naposes );
+}
+
+
+
+//
+// empty the chain before parsing
+//
+template<typename Storage, typename Accum>
+void poseIO<Storage,Accum>::clearChain( void )
+{
+   naposes   = 0;
+   nposes    = 0;
+   nclosures = 0;
+   steady    = false;
+   absVector.clear();
+   relVector.clear();
+   origVector.clear();
+   closeVector.clear();
+   startVector.clear();
+   endVector.clear();
+   sparseIndex.clear();
+   traInfoVector.clear();
+   rotInfoVector.clear();
+   scaleInfoVector.clear();
+   traCloseInfoVector.clear();
+   rotCloseInfoVector.clear();
+   infos.clear();
+   infoIndexVector.clear();
+   infoCloseIndexVector.clear();
+   reserveChain( 0 );
+}
+
+
+
+//
+// make sure pose n can be stored, new relative poses are identity
+//
+template<typename Storage, typename Accum>
+void poseIO<Storage,Accum>::reserveChain( const int an )
+{
+   if( (int)absVector.size() <= an )
+   {
+     absVector.resize(  an+1, sim3Store::Identity() );
+     relVector.resize(  an+1, sim3Store::Identity() );
+     origVector.resize( an+1, se3Store::Identity() );
+     traInfoVector.resize(   an+1 );
+     rotInfoVector.resize(   an+1 );
+     scaleInfoVector.resize( an+1 );
+     infoIndexVector.resize( an+1, -1 );
+   }
+}
+
+
+
+//
+// store an edge as relative pose or as loop closure
+//
+template<typename Storage, typename Accum>
+void poseIO<Storage,Accum>::storeEdge( const edgeRecord &aEdge, const int aInfo )
+{
+   se3Store pose = edgePose( aEdge );
+   
+   // decide between a relative pose or a loop closure pose
+   if( 1 == (aEdge.end - aEdge.start) )	
+   {  
+      // store in relVector together with a copy of the original
+      reserveChain( 1+nposes );
+      origVector[1+nposes] = pose;
+      relVector[1+nposes]  = sim3Store( pose );
+      
+      // store the mean variance for each pose
+      traInfoVector.set(   1+nposes, infos.tra( aInfo ) );
+      rotInfoVector.set(   1+nposes, infos.rot( aInfo ) );
+      scaleInfoVector.set( 1+nposes, 1.0f );
+      
+      // store the index of the original information values
+      infoIndexVector[1+nposes] = aInfo;
+      
+      // another relative pose found 
+      nposes++;	
+   }
+   else
+   {
+      // store in closeVector, SIM(3) loop closures keep their loop-closing scale
+      // loop closures are stored from the earlier to the later pose
+      if( aEdge.end < aEdge.start )
+      {  
+	closeVector.push_back( sim3Store( pose.inverse(), aEdge.s ) );
+	startVector.push_back( aEdge.end );
+	endVector.push_back( aEdge.start );
+      }
+      else
+      {
+	closeVector.push_back( sim3Store( pose, aEdge.s ) );
+	startVector.push_back( aEdge.start );
+	endVector.push_back( aEdge.end );
+      }
+      
+      // store the mean variance for each pose
+      traCloseInfoVector.push_back( infos.tra( aInfo ) );
+      rotCloseInfoVector.push_back( infos.rot( aInfo ) );
+      
+      // store the index of the original information values
+      infoCloseIndexVector.push_back( aInfo );
+      
+      // another loop closure found
+      nclosures++;	    	   
+   }
+}
+
+
+
+//
+// set the solution space and check the number of poses after parsing
+//
+template<typename Storage, typename Accum>
+bool poseIO<Storage,Accum>::checkChain( const long aLines, const int aSE3, const int aSIM3, const int aRT3 )
+{
    // check if we are acting on SE(3) or SIM(3)
-   if (0 < exp_naposes_se3)
+   int exp_naposes = 0;
+   if (0 < aSE3)
    {
       cout << "Solution space is SE(3)" << endl;
-      exp_naposes         = exp_naposes_se3;
+      exp_naposes         = aSE3;
       se3_solution_space  = true;
       sim3_solution_space = false;  
       rt3_solution_space  = false;          
    }
-   else if (0 < exp_naposes_sim3)
+   else if (0 < aSIM3)
    {
       cout << "Solution space is SIM(3)" << endl;
-      exp_naposes         = exp_naposes_sim3;
+      exp_naposes         = aSIM3;
       se3_solution_space  = false;
       sim3_solution_space = true;  
       rt3_solution_space  = false;        
    }
-   else if (0 < exp_naposes_rt3)
+   else if (0 < aRT3)
    {
       cout << "Solution space is RxT(3)" << endl;
-      exp_naposes         = exp_naposes_rt3;
+      exp_naposes         = aRT3;
       se3_solution_space  = false;
       sim3_solution_space = false;  
       rt3_solution_space  = true;
@@ -209,400 +524,13 @@ bool poseIO::parseInputFile()
    // for consistency checking compute the expected number of relative poses
    // and loop-closures
    int exp_nposes    = exp_naposes-1;
-   int exp_nclosures = nlines-(exp_nposes+exp_naposes);
+   int exp_nclosures = aLines-(exp_nposes+exp_naposes);
    cout << "Expected number of relative poses: " << exp_nposes << endl;
    cout << "Expected number of loop-closures: " << exp_nclosures << endl;
    
    
-   // reserve the memory
-   poseVector.resize( 4*exp_naposes  );
-   scaleVector.resize( exp_naposes, 1 ); 
-   closeVector.resize( exp_nclosures );
-   startVector.resize( exp_nclosures );
-   endVector.resize(   exp_nclosures );
-   traCloseInfoVector.resize( exp_nclosures, 1 );
-   rotCloseInfoVector.resize( exp_nclosures, 1 );
-   scaleCloseVector.resize(   exp_nclosures, 1 );
-   traInfoVector.resize(   exp_naposes, 1 );
-   rotInfoVector.resize(   exp_naposes, 1 );
-   scaleInfoVector.resize( exp_naposes, 1 );
-   infoVector.resize(         exp_naposes,   21 );
-   infoCloseVector.resize(    exp_nclosures, 21 );
-   traInfoVector(0,0) = 0.0f;
-   rotInfoVector(0,0) = 0.0f;
-   
-   // reset file   
-   inFile.clear();
-   inFile.seekg( 0, ios::beg );
-   
-   
-   // go through the file
-   stringstream stream;
-   Eigen::Quaternion<float>  *quat;   
-   Eigen::Matrix3f            rot;   
-   while( inFile.good() )
-   {
-      // find lines for SE(3) and SIM(3) and RxT(3) vertices
-      getline(inFile,line);
-      if( (line.substr(0,15) == "VERTEX_SE3:QUAT") || (line.substr(0,16) == "VERTEX_RST3:QUAT") || (line.substr(0,15) == "VERTEX_RT3:QUAT") )
-      {     
-	
-	 // parse an absolute pose
-	 stream.clear();
-	 stream.str(line);	 
-	 istream_iterator<std::string> begin(stream);
-         istream_iterator<std::string> end;
-         vector<std::string> vstrings(begin, end);
-	 
-	 // convert to numeric data
-	 tx = (float)atof( vstrings.at(2).c_str() );
-	 ty = (float)atof( vstrings.at(3).c_str() );
-	 tz = (float)atof( vstrings.at(4).c_str() );
-	 q1 = (float)atof( vstrings.at(5).c_str() );
-	 q2 = (float)atof( vstrings.at(6).c_str() );
-	 q3 = (float)atof( vstrings.at(7).c_str() );
-	 q4 = (float)atof( vstrings.at(8).c_str() );	
-	 Eigen::Quaternion<float> q(q4,q1,q2,q3);
-	 q.normalize();
-	 
-	 // create 4x4 homogenous matrix and store in poseVector
-	 poseVector[naposes*4] = Eigen::Translation<float,3>(tx,ty,tz) * q.toRotationMatrix();
-
-	 // initialize with identity matrices
-	 poseVector[(naposes*4)+1] = Eigen::Translation<float,3>(0.0f,0.0f,0.0f) * Eigen::Quaternion<float>(1.0f,0.0f,0.0f,0.0f);
-	 poseVector[(naposes*4)+2] = Eigen::Translation<float,3>(0.0f,0.0f,0.0f) * Eigen::Quaternion<float>(1.0f,0.0f,0.0f,0.0f);
-	 poseVector[(naposes*4)+3] = Eigen::Translation<float,3>(0.0f,0.0f,0.0f) * Eigen::Quaternion<float>(1.0f,0.0f,0.0f,0.0f);
-	 scaleVector(naposes,0)    = 1.0f;
-	 
-	 // another absolute pose found
-	 naposes++;
-	 
-      }
-      
-      // find lines for SE(3) edges
-      else if( (line.substr(0,13) == "EDGE_SE3:QUAT") || (line.substr(0,13) == "EDGE_RT3:QUAT") )
-      {
-	 // parse edge data
-         stream.clear();
-	 stream.str(line);	 
-	 istream_iterator<std::string> begin(stream);
-         istream_iterator<std::string> end;
-         vector<std::string> vstrings(begin, end);
-	 
-	 // convert to numeric data
-	 start_pose = atoi( vstrings.at(1).c_str() );
-	 end_pose   = atoi( vstrings.at(2).c_str() );
-	 tx         = (float)atof( vstrings.at(3).c_str() );
-	 ty         = (float)atof( vstrings.at(4).c_str() );
-	 tz         = (float)atof( vstrings.at(5).c_str() );
-	 q1         = (float)atof( vstrings.at(6).c_str() );
-	 q2         = (float)atof( vstrings.at(7).c_str() );
-	 q3         = (float)atof( vstrings.at(8).c_str() );
-	 q4         = (float)atof( vstrings.at(9).c_str() );	 
-	 Cov(0,0)   = (float)atof( vstrings.at(10).c_str() ); 	 	 	 		 	 	 
-	 Cov(0,1)   = (float)atof( vstrings.at(11).c_str() );
-	 Cov(1,0)   = (float)atof( vstrings.at(11).c_str() );	 	 
-	 Cov(0,2)   = (float)atof( vstrings.at(12).c_str() );
-	 Cov(2,0)   = (float)atof( vstrings.at(12).c_str() );
-	 Cov(0,3)   = (float)atof( vstrings.at(13).c_str() );
-	 Cov(3,0)   = (float)atof( vstrings.at(13).c_str() );
-	 Cov(0,4)   = (float)atof( vstrings.at(14).c_str() );
-	 Cov(4,0)   = (float)atof( vstrings.at(14).c_str() );
-	 Cov(0,5)   = (float)atof( vstrings.at(15).c_str() );
-	 Cov(5,0)   = (float)atof( vstrings.at(15).c_str() );	 
-	 Cov(1,1)   = (float)atof( vstrings.at(16).c_str() );	 
-	 Cov(1,2)   = (float)atof( vstrings.at(17).c_str() );
-	 Cov(2,1)   = (float)atof( vstrings.at(17).c_str() );
-	 Cov(1,3)   = (float)atof( vstrings.at(18).c_str() );
-	 Cov(3,1)   = (float)atof( vstrings.at(18).c_str() );
-	 Cov(1,4)   = (float)atof( vstrings.at(19).c_str() );
-	 Cov(4,1)   = (float)atof( vstrings.at(19).c_str() );
-	 Cov(1,5)   = (float)atof( vstrings.at(20).c_str() );
-	 Cov(5,1)   = (float)atof( vstrings.at(20).c_str() );	 
-	 Cov(2,2)   = (float)atof( vstrings.at(21).c_str() );	 
-	 Cov(2,3)   = (float)atof( vstrings.at(22).c_str() );
-	 Cov(3,2)   = (float)atof( vstrings.at(22).c_str() );
-	 Cov(2,4)   = (float)atof( vstrings.at(23).c_str() );
-	 Cov(4,2)   = (float)atof( vstrings.at(23).c_str() );
-	 Cov(2,5)   = (float)atof( vstrings.at(24).c_str() );
-	 Cov(5,2)   = (float)atof( vstrings.at(24).c_str() );	 
-	 Cov(3,3)   = (float)atof( vstrings.at(25).c_str() );	 
-	 Cov(3,4)   = (float)atof( vstrings.at(26).c_str() );
-	 Cov(4,3)   = (float)atof( vstrings.at(26).c_str() );
-	 Cov(3,5)   = (float)atof( vstrings.at(27).c_str() );
-	 Cov(5,3)   = (float)atof( vstrings.at(27).c_str() );	 
-	 Cov(4,4)   = (float)atof( vstrings.at(28).c_str() );	 
-	 Cov(4,5)   = (float)atof( vstrings.at(29).c_str() );
-	 Cov(5,4)   = (float)atof( vstrings.at(29).c_str() );	 
-	 Cov(5,5)   = (float)atof( vstrings.at(30).c_str() );
-	 tmp        = Cov;
-	 tmp        = tmp.inverse(); // from information to variance	 
-	 iqx        = tmp(3,3);
-	 iqy        = tmp(4,4);
-	 iqz        = tmp(5,5);  
-	 itx        = tmp(0,0);     
-	 ity        = tmp(1,1);      
-	 itz        = tmp(2,2);	
-	 Eigen::Quaternion<float> q(q4,q1,q2,q3);
-	 q.normalize();
-	 
-	 // decide between a relative pose or a loop closure pose
-	 if( 1 == (end_pose - start_pose) )	
-	 {  
-    
-	    // create 4x4 homogenous matrix and store in poseVector
-	    poseVector[5+nposes*4] = Eigen::Translation<float,3>(tx,ty,tz) * q.toRotationMatrix();
-	    poseVector[6+nposes*4] = Eigen::Translation<float,3>(tx,ty,tz) * q.toRotationMatrix(); // copy of original
-	    
-	    // store the mean variance for each pose
-	    traInfoVector(1+nposes,0) = pow( (sqrt(itx)+sqrt(ity)+sqrt(itz))/3, 2);
-	    
-	    rotInfoVector(1+nposes,0) = pow( (sqrt(iqx)+sqrt(iqy)+sqrt(iqz))/3, 2);
-	    
-	    // store original information values
-	    infoVector(1+nposes,0)  = Cov(0,0);
-	    infoVector(1+nposes,1)  = Cov(0,1);
-	    infoVector(1+nposes,2)  = Cov(0,2);
-	    infoVector(1+nposes,3)  = Cov(0,3);
-	    infoVector(1+nposes,4)  = Cov(0,4);
-	    infoVector(1+nposes,5)  = Cov(0,5);
-	    infoVector(1+nposes,6)  = Cov(1,1);
-	    infoVector(1+nposes,7)  = Cov(1,2);
-	    infoVector(1+nposes,8)  = Cov(1,3);
-	    infoVector(1+nposes,9)  = Cov(1,4);
-	    infoVector(1+nposes,10) = Cov(1,5);
-	    infoVector(1+nposes,11) = Cov(2,2);
-	    infoVector(1+nposes,12) = Cov(2,3);
-	    infoVector(1+nposes,13) = Cov(2,4);
-	    infoVector(1+nposes,14) = Cov(2,5);
-	    infoVector(1+nposes,15) = Cov(3,3);
-	    infoVector(1+nposes,16) = Cov(3,4);
-	    infoVector(1+nposes,17) = Cov(3,5);
-	    infoVector(1+nposes,18) = Cov(4,4);
-	    infoVector(1+nposes,19) = Cov(4,5);
-	    infoVector(1+nposes,20) = Cov(5,5);
-	    
-	    // another relative pose found 
-	    nposes++;	
-	 }
-	 else
-	 {
-	    // create 4x4 homogenous matrix and store in closeVector	 
-	    closeVector[nclosures] = Eigen::Translation<float,3>(tx,ty,tz) * q.toRotationMatrix();
-
-	    // store start and end pose number of loop closure
-	    if( end_pose < start_pose )
-	    {  
-	      closeVector[nclosures] = closeVector[nclosures].inverse(Eigen::Isometry);
-	      startVector[nclosures] = end_pose;
-	      endVector[  nclosures] = start_pose;	    
-	    }
-	    else
-	    {
-	      startVector[nclosures] = start_pose;
-	      endVector[  nclosures] = end_pose;		      
-	    }
-	    	      	    
-	    // store the mean variance for each pose
-	    traCloseInfoVector(nclosures) = pow( (sqrt(itx)+sqrt(ity)+sqrt(itz))/3, 2 );	    
-	    
-	    rotCloseInfoVector(nclosures) = pow( (sqrt(iqx)+sqrt(iqy)+sqrt(iqz))/3, 2 );	    
-	    	    	    
-	   	 
-	    // store original information values
-	    infoCloseVector(nclosures,0)  = Cov(0,0);
-	    infoCloseVector(nclosures,1)  = Cov(0,1);
-	    infoCloseVector(nclosures,2)  = Cov(0,2);
-	    infoCloseVector(nclosures,3)  = Cov(0,3);
-	    infoCloseVector(nclosures,4)  = Cov(0,4);
-	    infoCloseVector(nclosures,5)  = Cov(0,5);
-	    infoCloseVector(nclosures,6)  = Cov(1,1);
-	    infoCloseVector(nclosures,7)  = Cov(1,2);
-	    infoCloseVector(nclosures,8)  = Cov(1,3);
-	    infoCloseVector(nclosures,9)  = Cov(1,4);
-	    infoCloseVector(nclosures,10) = Cov(1,5);
-	    infoCloseVector(nclosures,11) = Cov(2,2);
-	    infoCloseVector(nclosures,12) = Cov(2,3);
-	    infoCloseVector(nclosures,13) = Cov(2,4);
-	    infoCloseVector(nclosures,14) = Cov(2,5);
-	    infoCloseVector(nclosures,15) = Cov(3,3);
-	    infoCloseVector(nclosures,16) = Cov(3,4);
-	    infoCloseVector(nclosures,17) = Cov(3,5);
-	    infoCloseVector(nclosures,18) = Cov(4,4);
-	    infoCloseVector(nclosures,19) = Cov(4,5);
-	    infoCloseVector(nclosures,20) = Cov(5,5);
-	    
-	    // another loop closure found
-	    nclosures++;	    	   
-	 }
-      }
-      
-      
-      // find lines for SIM(3) edges
-      else if( line.substr(0,14) == "EDGE_RST3:QUAT" )
-      {
-	
-	 // parse edge data
-         stream.clear();
-	 stream.str(line);	 
-	 istream_iterator<std::string> begin(stream);
-         istream_iterator<std::string> end;
-         vector<std::string> vstrings(begin, end);
-	 
-	 // convert to numeric data
-	 start_pose = atoi( vstrings.at(1).c_str() );
-	 end_pose   = atoi( vstrings.at(2).c_str() );	 	 
-	 tx         = (float)atof( vstrings.at(3).c_str() );
-	 ty         = (float)atof( vstrings.at(4).c_str() );
-	 tz         = (float)atof( vstrings.at(5).c_str() );
-	 q1         = (float)atof( vstrings.at(6).c_str() );
-	 q2         = (float)atof( vstrings.at(7).c_str() );
-	 q3         = (float)atof( vstrings.at(8).c_str() );
-	 q4         = (float)atof( vstrings.at(9).c_str() );
-	 scale      = (float)atof( vstrings.at(10).c_str() );
-	 Cov(0,0)   = (float)atof( vstrings.at(11).c_str() ); 	 	 	 		 	 	 
-	 Cov(0,1)   = (float)atof( vstrings.at(12).c_str() );
-	 Cov(1,0)   = (float)atof( vstrings.at(12).c_str() );	 	 
-	 Cov(0,2)   = (float)atof( vstrings.at(13).c_str() );
-	 Cov(2,0)   = (float)atof( vstrings.at(13).c_str() );
-	 Cov(0,3)   = (float)atof( vstrings.at(14).c_str() );
-	 Cov(3,0)   = (float)atof( vstrings.at(14).c_str() );
-	 Cov(0,4)   = (float)atof( vstrings.at(15).c_str() );
-	 Cov(4,0)   = (float)atof( vstrings.at(15).c_str() );
-	 Cov(0,5)   = (float)atof( vstrings.at(16).c_str() );
-	 Cov(5,0)   = (float)atof( vstrings.at(16).c_str() );	 
-	 Cov(1,1)   = (float)atof( vstrings.at(17).c_str() );	 
-	 Cov(1,2)   = (float)atof( vstrings.at(18).c_str() );
-	 Cov(2,1)   = (float)atof( vstrings.at(18).c_str() );
-	 Cov(1,3)   = (float)atof( vstrings.at(19).c_str() );
-	 Cov(3,1)   = (float)atof( vstrings.at(19).c_str() );
-	 Cov(1,4)   = (float)atof( vstrings.at(20).c_str() );
-	 Cov(4,1)   = (float)atof( vstrings.at(20).c_str() );
-	 Cov(1,5)   = (float)atof( vstrings.at(21).c_str() );
-	 Cov(5,1)   = (float)atof( vstrings.at(21).c_str() );	 
-	 Cov(2,2)   = (float)atof( vstrings.at(22).c_str() );	 
-	 Cov(2,3)   = (float)atof( vstrings.at(23).c_str() );
-	 Cov(3,2)   = (float)atof( vstrings.at(23).c_str() );
-	 Cov(2,4)   = (float)atof( vstrings.at(24).c_str() );
-	 Cov(4,2)   = (float)atof( vstrings.at(24).c_str() );
-	 Cov(2,5)   = (float)atof( vstrings.at(25).c_str() );
-	 Cov(5,2)   = (float)atof( vstrings.at(25).c_str() );	 
-	 Cov(3,3)   = (float)atof( vstrings.at(26).c_str() );	 
-	 Cov(3,4)   = (float)atof( vstrings.at(27).c_str() );
-	 Cov(4,3)   = (float)atof( vstrings.at(27).c_str() );
-	 Cov(3,5)   = (float)atof( vstrings.at(28).c_str() );
-	 Cov(5,3)   = (float)atof( vstrings.at(28).c_str() );	 
-	 Cov(4,4)   = (float)atof( vstrings.at(29).c_str() );	 
-	 Cov(4,5)   = (float)atof( vstrings.at(30).c_str() );
-	 Cov(5,4)   = (float)atof( vstrings.at(30).c_str() );	 
-	 Cov(5,5)   = (float)atof( vstrings.at(31).c_str() );
-	 tmp        = Cov;
-	 tmp        = tmp.inverse(); // from information to variance	 
-	 iqx        = tmp(3,3);
-	 iqy        = tmp(4,4);
-	 iqz        = tmp(5,5);  
-	 itx        = tmp(0,0);     
-	 ity        = tmp(1,1);      
-	 itz        = tmp(2,2);	
-	 Eigen::Quaternion<float> q(q4,q1,q2,q3);
-	 q.normalize();
-	 
-	 // decide between a relative pose or a loop closure pose
-	 if( 1 == (end_pose - start_pose) )	
-	 {  
-	    // create 4x4 homogenous matrix and store in poseVector	 
-	    poseVector[5+nposes*4] = Eigen::Translation<float,3>(tx,ty,tz) * q.toRotationMatrix();
-            poseVector[6+nposes*4] = Eigen::Translation<float,3>(tx,ty,tz) * q.toRotationMatrix(); // copy of original
-	    
-	    // store the maximum variance for each pose
-	    traInfoVector(1+nposes,0) = pow( (sqrt(itx)+sqrt(ity)+sqrt(itz))/3, 2);
-	    
-	    rotInfoVector(1+nposes,0) = pow( (sqrt(iqx)+sqrt(iqy)+sqrt(iqz))/3, 2);
-	    
-	    scaleInfoVector(1+nposes,0) = 1.0f;
-	    
-	    // store original information values
-	    infoVector(1+nposes,0)  = Cov(0,0);
-	    infoVector(1+nposes,1)  = Cov(0,1);
-	    infoVector(1+nposes,2)  = Cov(0,2);
-	    infoVector(1+nposes,3)  = Cov(0,3);
-	    infoVector(1+nposes,4)  = Cov(0,4);
-	    infoVector(1+nposes,5)  = Cov(0,5);
-	    infoVector(1+nposes,6)  = Cov(1,1);
-	    infoVector(1+nposes,7)  = Cov(1,2);
-	    infoVector(1+nposes,8)  = Cov(1,3);
-	    infoVector(1+nposes,9)  = Cov(1,4);
-	    infoVector(1+nposes,10) = Cov(1,5);
-	    infoVector(1+nposes,11) = Cov(2,2);
-	    infoVector(1+nposes,12) = Cov(2,3);
-	    infoVector(1+nposes,13) = Cov(2,4);
-	    infoVector(1+nposes,14) = Cov(2,5);
-	    infoVector(1+nposes,15) = Cov(3,3);
-	    infoVector(1+nposes,16) = Cov(3,4);
-	    infoVector(1+nposes,17) = Cov(3,5);
-	    infoVector(1+nposes,18) = Cov(4,4);
-	    infoVector(1+nposes,19) = Cov(4,5);
-	    infoVector(1+nposes,20) = Cov(5,5);
-	 
-	    // another relative pose found 
-	    nposes++;	
-	 }
-	 else
-	 {
-	    // create 4x4 homogenous matrix and store in closeVector	 
-	    closeVector[nclosures] = Eigen::Translation<float,3>(tx,ty,tz) * q.toRotationMatrix();
-	    closeVector[nclosures] = closeVector[nclosures].inverse(Eigen::Isometry);
-	    
-	    // store the loop-closing scale
-	    scaleCloseVector(nclosures) = scale;
-	    
-	    // store the maximum variance for each pose
-	    traCloseInfoVector(nclosures) = pow( (sqrt(itx)+sqrt(ity)+sqrt(itz))/3, 2 );	    
-	    
-	    rotCloseInfoVector(nclosures) = pow( (sqrt(iqx)+sqrt(iqy)+sqrt(iqz))/3, 2 );	    
-	    		    
-	    // store start and end pose number of loop closure
-	    startVector[nclosures] = end_pose;
-	    endVector[  nclosures] = start_pose;
-	   	
-	    // store original information values
-	    infoCloseVector(nclosures,0)  = Cov(0,0);
-	    infoCloseVector(nclosures,1)  = Cov(0,1);
-	    infoCloseVector(nclosures,2)  = Cov(0,2);
-	    infoCloseVector(nclosures,3)  = Cov(0,3);
-	    infoCloseVector(nclosures,4)  = Cov(0,4);
-	    infoCloseVector(nclosures,5)  = Cov(0,5);
-	    infoCloseVector(nclosures,6)  = Cov(1,1);
-	    infoCloseVector(nclosures,7)  = Cov(1,2);
-	    infoCloseVector(nclosures,8)  = Cov(1,3);
-	    infoCloseVector(nclosures,9)  = Cov(1,4);
-	    infoCloseVector(nclosures,10) = Cov(1,5);
-	    infoCloseVector(nclosures,11) = Cov(2,2);
-	    infoCloseVector(nclosures,12) = Cov(2,3);
-	    infoCloseVector(nclosures,13) = Cov(2,4);
-	    infoCloseVector(nclosures,14) = Cov(2,5);
-	    infoCloseVector(nclosures,15) = Cov(3,3);
-	    infoCloseVector(nclosures,16) = Cov(3,4);
-	    infoCloseVector(nclosures,17) = Cov(3,5);
-	    infoCloseVector(nclosures,18) = Cov(4,4);
-	    infoCloseVector(nclosures,19) = Cov(4,5);
-	    infoCloseVector(nclosures,20) = Cov(5,5);
-	    
-	    // another loop closure found
-	    nclosures++;	    	   
-	 }
-      }     
-      
-      
-   }     
-   
-   
-   // close the file   
-   inFile.close();
-   
-   
    // do a consistency check
-   if( (exp_naposes != naposes) || (exp_nposes != nposes) || (exp_nclosures != nclosures) )
+   if( (exp_naposes != naposes) || (exp_nposes != nposes) || (exp_nclosures != nclosures) || ((int)absVector.size() != naposes) )
    {
       cout << "Number of poses is not consistent" << endl;
       cout << "Absolute poses " << naposes << "/" << exp_naposes << ",   Relative poses " << nposes << "/" << exp_nposes << ",   Closure poses " << nclosures << "/" << exp_nclosures << endl;
@@ -618,6 +546,10 @@ bool poseIO::parseInputFile()
    syncChain();
    
    
+   // the chain is complete, running COP-SLAM on it does not allocate
+   presize( naposes, nclosures, infos.size() );
+   
+   
    // all ok
    return true;
 }
@@ -626,12 +558,21 @@ bool poseIO::parseInputFile()
 //
 // write the optimized graph to the output file
 //
-bool poseIO::writeOutputFile()
+template<typename Storage, typename Accum>
+bool poseIO<Storage,Accum>::writeOutputFile()
 {
   
-   // open the file for writing
+   // a binary graph is written for the .bin extension
+   if( (4 <= oFile.size()) && (0 == oFile.compare( oFile.size()-4, 4, ".bin" )) )
+     return writeBinaryFile();
+   
+   
+   // open the file for writing, the lines are collected in a large buffer that is written when full
    cout << "Opening file: " << oFile << " for writing." << endl;
-   ofstream outFile( oFile.c_str(), ios::out );
+   vector<char> buffer( WRITE_BUFFER );
+   ofstream     outFile;
+   outFile.rdbuf()->pubsetbuf( &buffer[0], buffer.size() );
+   outFile.open( oFile.c_str(), ios::out );
   
    
    // could not open file 
@@ -640,106 +581,384 @@ bool poseIO::writeOutputFile()
       cerr << "Unable to create output file: " << oFile << endl;
       return false;
    }
+   
+   
+   // a file ending in .gz is compressed while it is written
+   bool                   compressed = (3 <= oFile.size()) && (0 == oFile.compare( oFile.size()-3, 3, ".gz" ));
+   unique_ptr<gzipOutBuf> compressor( compressed ? new gzipOutBuf( outFile.rdbuf() ) : 0 );
+   ostream                output( compressed ? (streambuf*)compressor.get() : outFile.rdbuf() );
   
   
-   //write all absolute poses
-   Eigen::Affine3f          tmp;
-   Eigen::Quaternion<float> quat;
-   float                    scale = 1.0f;
-   for( int n = 0; n < poseVector.size(); n = n+4 )
+   // the information values of each distinct matrix are formatted once, the threads take every nthreads-th matrix
+   int            nthreads = this->pool.size();
+   vector<string> infoText( infos.size() );
+   this->pool.run( nthreads, [&]( int k )
    {
-	// write the pose
-	tmp   = poseVector[n];	
-	quat  = tmp.rotation();
-        scale = scaleVector(n/4);
-	if( se3_solution_space )
-	  outFile << scientific << "VERTEX_SE3:QUAT " << n/4 << " " << tmp(0,3) << " " << tmp(1,3) << " " << tmp(2,3) << " "  << quat.x() << " " << quat.y() << " " << quat.z() << " " << quat.w() << endl;
-	else if ( sim3_solution_space )
-	  outFile << scientific << "VERTEX_RST3:QUAT " << n/4 << " " << tmp(0,3) << " " << tmp(1,3) << " " << tmp(2,3) << " "  << quat.x() << " " << quat.y() << " " << quat.z() << " " << quat.w() << " " << scale << endl;
-	else if ( rt3_solution_space )
-	  outFile << scientific << "VERTEX_RT3:QUAT " << n/4 << " " << tmp(0,3) << " " << tmp(1,3) << " " << tmp(2,3) << " "  << quat.x() << " " << quat.y() << " " << quat.z() << " " << quat.w() << " " << endl;
-    }
+     for( int i = k; i < (int)infoText.size(); i += nthreads )
+     {
+       ostringstream values;
+       for( int j = 0; j < 21; j++ )
+	 values << scientific << infos.info( i )[j] << " ";
+       infoText[i] = values.str();
+     }
+   } );
+  
+  
+   //write all absolute poses and all relative poses, each relative pose followed by the loops ending in its pose
+   //ranges of WRITE_RANGE lines are formatted on the threads, one range per thread at a time, and written in order
+   vector<int> closureFirst, closureOrder;
+   closuresByEnd( closureFirst, closureOrder );
+   //the lines of a chain of a billion poses exceed the range of an int, the poses of the ranges are paged in first
+   long           nvertices = absVector.size();
+   long           nitems    = nvertices + max( 0L, (long)origVector.size()-1 );
+   vector<string> text( this->pool.size() );
+   for( long first = 0; first < nitems; first += WRITE_RANGE*text.size() )
+   {
+      int  nranges = min( (long)text.size(), (nitems-first+WRITE_RANGE-1)/WRITE_RANGE );
+      long last    = min( nitems, first+(long)WRITE_RANGE*nranges );
+      absVector.touch( first, min( nvertices, last )-1 );
+      if( nvertices < last )
+	origVector.touch( max( 1L, first-nvertices+1 ), last-nvertices );
+      this->pool.run( nranges, [&]( int k )
+      {
+	ostringstream lines;
+	long          begin = first + (long)k*WRITE_RANGE;
+	long          end   = min( nitems, begin+WRITE_RANGE );
+	for( long i = begin; i < end; i++ )
+	  if( i < nvertices )
+	    writeVertex( lines, i );
+	  else
+	    writeEdges( lines, i-nvertices+1, closureFirst, closureOrder, infoText );
+	text[k] = lines.str();
+      } );
+      for( int k = 0; k < nranges; k++ )
+	output.write( text[k].data(), text[k].size() );
+   }
+            
+   // close the file   
+   bool ok = output.good() && (!compressed || compressor->close());
+   outFile.close();
+   if( !ok || !outFile )
+   {
+      cerr << "Unable to write output file: " << oFile << endl;
+      return false;
+   }
+   
+        
+   // all ok
+   return true;  
+}
+
+
+
+//
+// write the optimized graph as binary graph, the edges are in the order of the g2o output
+// the weights are stored in double precision, such that they are exact for all scalar types
+//
+template<typename Storage, typename Accum>
+bool poseIO<Storage,Accum>::writeBinaryFile( void )
+{
+   cout << "Opening file: " << oFile << " for writing." << endl;
+   
+   
+   // the absolute poses
+   vector<vertexRecord> vertices( absVector.size() );
+   for( int n = 0; n < (int)absVector.size(); n++ )
+   {
+      if( 0 == n % WRITE_RANGE )
+	absVector.touch( n, n+WRITE_RANGE-1 );
+      se3Store                   tmp = absVector[n].rigid();
+      Eigen::Quaternion<Storage> quat( tmp.rotation() );
+      for( int i = 0; i < 3; i++ )
+	vertices[n].t[i] = tmp.t(i);
+      vertices[n].q[0] = quat.x();
+      vertices[n].q[1] = quat.y();
+      vertices[n].q[2] = quat.z();
+      vertices[n].q[3] = quat.w();
+      vertices[n].s    = sim3_solution_space ? absVector[n].s : 1.0f;
+   }
    
    
-   //write all relative poses
-   for( int n = 4; n < poseVector.size(); n = n+4 )
+   // an edge from a pose with its information values and their weights
+   vector<edgeRecord> edges;
+   auto addEdge = [&]( const int astart, const int aend, const se3Store &apose, const Storage ascale, const int ainfo )
+   {
+      edgeRecord                 edge;
+      Eigen::Quaternion<Storage> quat( apose.rotation() );
+      edge.start = astart;
+      edge.end   = aend;
+      for( int i = 0; i < 3; i++ )
+	edge.t[i] = apose.t(i);
+      edge.q[0] = quat.x();
+      edge.q[1] = quat.y();
+      edge.q[2] = quat.z();
+      edge.q[3] = quat.w();
+      edge.s    = ascale;
+      edge.pad  = 0.0f;
+      for( int k = 0; k < 21; k++ )
+	edge.info[k] = infos.info( ainfo )[k];
+      edge.tra = infos.tra( ainfo );
+      edge.rot = infos.rot( ainfo );
+      edges.push_back( edge );
+   };
+   
+   
+   // the relative poses, each followed by the loop closures ending in its pose
+   vector<int> closureFirst, closureOrder;
+   closuresByEnd( closureFirst, closureOrder );
+   for( int n = 1; n < (int)origVector.size(); n++ )
+   {
+      if( 1 == n % WRITE_RANGE )
+	origVector.touch( n, n+WRITE_RANGE-1 );
+      addEdge( n-1, n, origVector[n], 1.0f, infoIndexVector[n] );
+      for( int k = closureFirst[n]; k < closureFirst[n+1]; k++ )
+      {
+	int m = closureOrder[k];
+	addEdge( endVector[m], startVector[m], closeVector[m].rigid().inverse(), sim3_solution_space ? closeVector[m].s : 1.0f, infoCloseIndexVector[m] );
+      }
+   }
+   
+   
+   // write the file
+   int space = sim3_solution_space ? SPACE_SIM3 : (rt3_solution_space ? SPACE_RT3 : SPACE_SE3);
+   if( !binaryGraph::write( oFile, space, vertices, edges ) )
+   {
+      cerr << "Unable to create output file: " << oFile << endl;
+      return false;
+   }
+   return true;
+}
+
+
+
+//
+// index of the loop closures by their end pose, i.e. a counting sort of endVector
+// the closures ending in pose n are aOrder[aFirst[n]] upto aOrder[aFirst[n+1]], in the order in which they were read
+//
+template<typename Storage, typename Accum>
+void poseIO<Storage,Accum>::closuresByEnd( vector<int> &aFirst, vector<int> &aOrder ) const
+{
+   int nends = origVector.size();
+   aFirst.assign( nends+1, 0 );
+   for( int m = 0; m < (int)endVector.size(); m++ )
+     if( (0 <= endVector[m]) && (endVector[m] < nends) )
+       aFirst[endVector[m]+1]++;
+   for( int n = 0; n < nends; n++ )
+     aFirst[n+1] += aFirst[n];
+   aOrder.resize( aFirst[nends] );
+   vector<int> next( aFirst.begin(), aFirst.end()-1 );
+   for( int m = 0; m < (int)endVector.size(); m++ )
+     if( (0 <= endVector[m]) && (endVector[m] < nends) )
+       aOrder[next[endVector[m]]++] = m;
+}
+
+
+
+//
+// write relative pose n as an edge line, followed by the loop closures ending in pose n
+//
+template<typename Storage, typename Accum>
+void poseIO<Storage,Accum>::writeEdges( ostream &aOutput, const int an, const vector<int> &aClosureFirst, const vector<int> &aClosureOrder, const vector<string> &aInfoText )
+{
+   se3Store                   tmp;
+   Eigen::Quaternion<Storage> quat;
+   Storage                    scale = 1.0f;
+   
+   // write the pose
+   tmp  = origVector[an];
+   quat = tmp.rotation();
+   if( se3_solution_space )
+   {
+     aOutput << scientific << "EDGE_SE3:QUAT " << an-1 << " " << an << " " << tmp.t(0) << " " << tmp.t(1) << " " << tmp.t(2) << " "  << quat.x() << " " << quat.y() << " " << quat.z() << " " << quat.w() << " ";
+     aOutput << aInfoText[infoIndexVector[an]];
+     aOutput << '\n';
+   }
+   else if ( sim3_solution_space )
+   {
+     aOutput << scientific << "EDGE_RST3:QUAT " << an-1 << " " << an << " " << tmp.t(0) << " " << tmp.t(1) << " " << tmp.t(2) << " "  << quat.x() << " " << quat.y() << " " << quat.z() << " " << quat.w() << " 1.0 ";
+     aOutput << aInfoText[infoIndexVector[an]];
+     aOutput << '\n';	  
+   }
+   else if ( rt3_solution_space )
    {
-	// write the pose
-	tmp  = poseVector[n+2];
-	quat = tmp.rotation();
-	if( se3_solution_space )
+     aOutput << scientific << "EDGE_RT3:QUAT " << an-1 << " " << an << " " << tmp.t(0) << " " << tmp.t(1) << " " << tmp.t(2) << " "  << quat.x() << " " << quat.y() << " " << quat.z() << " " << quat.w() << " ";
+     aOutput << aInfoText[infoIndexVector[an]];
+     aOutput << '\n';	  
+   }
+
+   // the loops ending in this pose
+   for( int k = aClosureFirst[an]; k < aClosureFirst[an+1]; k++ )
+   {
+     int m = aClosureOrder[k];
+     tmp   = closeVector[m].rigid().inverse();
+     quat  = tmp.rotation();
+     scale = closeVector[m].s; 
+     if( se3_solution_space )
+     {
+       aOutput << scientific << "EDGE_SE3:QUAT " << endVector[m] << " " << startVector[m] << " "  << tmp.t(0) << " " << tmp.t(1) << " " << tmp.t(2) << " "  << quat.x() << " " << quat.y() << " " << quat.z() << " " << quat.w() << " ";
+       aOutput << aInfoText[infoCloseIndexVector[m]];
+       aOutput << '\n';	
+     }
+     else if ( sim3_solution_space )
+     {
+       aOutput << scientific << "EDGE_RST3:QUAT " << endVector[m] << " " << startVector[m] << " "  << tmp.t(0) << " " << tmp.t(1) << " " << tmp.t(2) << " "  << quat.x() << " " << quat.y() << " " << quat.z() << " " << quat.w() << " " << scale << " ";
+       aOutput << aInfoText[infoCloseIndexVector[m]];
+       aOutput << '\n';	
+     }
+     else if ( rt3_solution_space )
+     {
+       aOutput << scientific << "EDGE_RT3:QUAT " << endVector[m] << " " << startVector[m] << " "  << tmp.t(0) << " " << tmp.t(1) << " " << tmp.t(2) << " "  << quat.x() << " " << quat.y() << " " << quat.z() << " " << quat.w() << " ";
+       aOutput << aInfoText[infoCloseIndexVector[m]];
+       aOutput << '\n';	
+     }	    
+   }	
+}
+
+
+
+//
+// write absolute pose n as a vertex line
+//
+template<typename Storage, typename Accum>
+void poseIO<Storage,Accum>::writeVertex( ostream &aOutput, const int an )
+{
+   se3Store                   tmp   = absVector[an].rigid();
+   Eigen::Quaternion<Storage> quat( tmp.rotation() );
+   Storage                    scale = absVector[an].s;
+   if( se3_solution_space )
+     aOutput << scientific << "VERTEX_SE3:QUAT " << an << " " << tmp.t(0) << " " << tmp.t(1) << " " << tmp.t(2) << " "  << quat.x() << " " << quat.y() << " " << quat.z() << " " << quat.w() << '\n';
+   else if ( sim3_solution_space )
+     aOutput << scientific << "VERTEX_RST3:QUAT " << an << " " << tmp.t(0) << " " << tmp.t(1) << " " << tmp.t(2) << " "  << quat.x() << " " << quat.y() << " " << quat.z() << " " << quat.w() << " " << scale << '\n';
+   else if ( rt3_solution_space )
+     aOutput << scientific << "VERTEX_RT3:QUAT " << an << " " << tmp.t(0) << " " << tmp.t(1) << " " << tmp.t(2) << " "  << quat.x() << " " << quat.y() << " " << quat.z() << " " << quat.w() << " " << '\n';
+}
+
+
+
+//
+// the absolute pose of a vertex record, with unit scale
+//
+template<typename Storage, typename Accum>
+typename poseIO<Storage,Accum>::sim3Store poseIO<Storage,Accum>::vertexPose( const vertexRecord &aVertex )
+{
+   Eigen::Quaternion<Storage> q( aVertex.q[3], aVertex.q[0], aVertex.q[1], aVertex.q[2] );
+   q.normalize();
+   return sim3Store( q.toRotationMatrix(), vector3Store( aVertex.t[0], aVertex.t[1], aVertex.t[2] ), 1.0f );
+}
+
+
+
+//
+// the relative pose of an edge record
+//
+template<typename Storage, typename Accum>
+typename poseIO<Storage,Accum>::se3Store poseIO<Storage,Accum>::edgePose( const edgeRecord &aEdge )
+{
+   Eigen::Quaternion<Storage> q( aEdge.q[3], aEdge.q[0], aEdge.q[1], aEdge.q[2] );
+   q.normalize();
+   return se3Store( q.toRotationMatrix(), vector3Store( aEdge.t[0], aEdge.t[1], aEdge.t[2] ) );
+}
+
+
+
+//
+// the information matrix of an edge record
+//
+template<typename Storage, typename Accum>
+void poseIO<Storage,Accum>::edgeInfo( const edgeRecord &aEdge, Eigen::Matrix<float,6,6> &aInfo )
+{
+   for( int i = 0, k = 0; i < 6; i++ )
+     for( int j = i; j < 6; j++, k++ )
+     {
+       aInfo(i,j) = aEdge.info[k];
+       aInfo(j,i) = aEdge.info[k];
+     }
+}
+
+
+
+//
+// process a graph while it is being read
+// the chain starts at the first vertex, the other vertices are not used since the
+// absolute poses follow from the edges, the edges have to be in online order
+//
+template<typename Storage, typename Accum>
+bool poseIO<Storage,Accum>::streamGraph( istream &aInput, ostream &aOutput )
+{
+   string                   line;
+   bool                     started = false;
+   int                      first;
+   vertexRecord             vertexData;
+   edgeRecord               edgeData;
+   sim3Store                origin;
+   Eigen::Matrix<float,6,6> info;
+   while( getline( aInput, line ) )
+   {
+      int  type   = graphLine( line.c_str(), line.size() );
+      bool vertex = (LINE_VERTEX_SE3 == type) || (LINE_VERTEX_RST3 == type) || (LINE_VERTEX_RT3 == type);
+      bool edge   = (LINE_EDGE_SE3   == type) || (LINE_EDGE_RST3   == type) || (LINE_EDGE_RT3   == type);
+      
+      // the first vertex or edge determines the solution space and starts the chain
+      if( !started && (vertex || edge) )
+      {
+	se3_solution_space  = (LINE_VERTEX_SE3  == type) || (LINE_EDGE_SE3  == type);
+	sim3_solution_space = (LINE_VERTEX_RST3 == type) || (LINE_EDGE_RST3 == type);
+	rt3_solution_space  = (LINE_VERTEX_RT3  == type) || (LINE_EDGE_RT3  == type);
+	origin = sim3Store::Identity();
+	if( vertex && !scanVertex( line.c_str(), line.c_str()+line.size(), vertexData ) )
 	{
-	  outFile << scientific << "EDGE_SE3:QUAT " << (n/4)-1 << " " << (n/4) << " " << tmp(0,3) << " " << tmp(1,3) << " " << tmp(2,3) << " "  << quat.x() << " " << quat.y() << " " << quat.z() << " " << quat.w() << " ";
-	  for( int i = 0; i < 21; i++ )
-	  {
-	     outFile << scientific << infoVector((n/4),i) << " ";
-	  }
-	  outFile << endl;
+	  cerr << "Unable to parse: " << line << endl;
+	  return false;
 	}
-	else if ( sim3_solution_space )
+	if( vertex )
+	  origin = vertexPose( vertexData );
+	startChain( origin );
+	writeVertex( aOutput, 0 );
+	started = true;
+      }
+      else if( edge )
+      {
+	if( !scanEdge( line.c_str(), line.c_str()+line.size(), edgeData ) )
 	{
-	  outFile << scientific << "EDGE_RST3:QUAT " << (n/4)-1 << " " << (n/4) << " " << tmp(0,3) << " " << tmp(1,3) << " " << tmp(2,3) << " "  << quat.x() << " " << quat.y() << " " << quat.z() << " " << quat.w() << " 1.0 ";
-	  for( int i = 0; i < 21; i++ )
-	  {
-	     outFile << scientific << infoVector((n/4),i) << " ";
-	  }
-	  outFile << endl;	  
+	  cerr << "Unable to parse: " << line << endl;
+	  return false;
 	}
-	else if ( rt3_solution_space )
+	edgeInfo( edgeData, info );
+	
+	// decide between a relative pose or a loop closure pose
+	if( 1 == (edgeData.end - edgeData.start) )
 	{
-	  outFile << scientific << "EDGE_RT3:QUAT " << (n/4)-1 << " " << (n/4) << " " << tmp(0,3) << " " << tmp(1,3) << " " << tmp(2,3) << " "  << quat.x() << " " << quat.y() << " " << quat.z() << " " << quat.w() << " ";
-	  for( int i = 0; i < 21; i++ )
+	  if( edgeData.end != naposes )
 	  {
-	     outFile << scientific << infoVector((n/4),i) << " ";
+	    cerr << "Relative pose from " << edgeData.start << " to " << edgeData.end << " is not in online order" << endl;
+	    return false;
 	  }
-	  outFile << endl;	  
+	  addRelativePose( edgePose( edgeData ), info );
+	  writeVertex( aOutput, edgeData.end );
 	}
-	
-	// is there a loop ending in this pose
-	for( int m = 0; m < closeVector.size(); m++ )  
+	else
 	{
-	  if( (n/4) == endVector[m] )
-	  {
-	    tmp   = closeVector[m].inverse(Eigen::Isometry);
-	    quat  = tmp.rotation();
-	    scale = scaleCloseVector(m); 
-	    if( se3_solution_space )
-	    {
-	      outFile << scientific << "EDGE_SE3:QUAT " << endVector[m] << " " << startVector[m] << " "  << tmp(0,3) << " " << tmp(1,3) << " " << tmp(2,3) << " "  << quat.x() << " " << quat.y() << " " << quat.z() << " " << quat.w() << " ";
-	      for( int i = 0; i < 21; i++ )
-	      {
-		outFile << scientific << infoCloseVector(m,i) << " ";
-	      }
-	      outFile << endl;	
-	    }
-	    else if ( sim3_solution_space )
-	    {
-	      outFile << scientific << "EDGE_RST3:QUAT " << endVector[m] << " " << startVector[m] << " "  << tmp(0,3) << " " << tmp(1,3) << " " << tmp(2,3) << " "  << quat.x() << " " << quat.y() << " " << quat.z() << " " << quat.w() << " " << scale << " ";
-	      for( int i = 0; i < 21; i++ )
-	      {
-		outFile << scientific << infoCloseVector(m,i) << " ";
-	      }
-	      outFile << endl;	
-	    }
-	    else if ( rt3_solution_space )
-	    {
-	      outFile << scientific << "EDGE_RT3:QUAT " << endVector[m] << " " << startVector[m] << " "  << tmp(0,3) << " " << tmp(1,3) << " " << tmp(2,3) << " "  << quat.x() << " " << quat.y() << " " << quat.z() << " " << quat.w() << " ";
-	      for( int i = 0; i < 21; i++ )
-	      {
-		outFile << scientific << infoCloseVector(m,i) << " ";
-	      }
-	      outFile << endl;	
-	    }	    
-	  }
-	}	
+	  first = addLoopClosure( edgeData.start, edgeData.end, edgePose( edgeData ), info, edgeData.s );
+	  for( int n = first; n < naposes; n++ )
+	    writeVertex( aOutput, n );
+	}
       }
-
-            
-   // close the file   
-   outFile.close();
+      
+      // hand over the poses before waiting for more input
+      if( aInput.rdbuf()->in_avail() <= 0 )
+	aOutput.flush();
+   }
+   aOutput.flush();
    
-        
-   // all ok
-   return true;  
+   
+   // user feedback
+   cout << "Streamed " << naposes << " absolute poses and " << nclosures << " loop closures" << endl;
+   return started;
 }
 
+
+
+// the supported combinations of storage and accumulation types
+template class poseIO<float,float>;
+template class poseIO<double,double>;
+template class poseIO<float,double>;
@@ -0,0 +1,167 @@
+
+
+
+#include "threadPool.hpp"
+
+
+
+//
+// constructor
+//
+threadPool::threadPool( const int anthreads )
+{
+  task   = 0;
+  call   = 0;
+  ntasks = 0;
+  next   = 0;
+  busy   = 0;
+  batch  = 0;
+  quit   = false;
+  start( anthreads );
+}
+
+
+
+//
+// destructor
+//
+threadPool::~threadPool()
+{
+  stop();
+}
+
+
+
+//
+// return the number of threads, including the calling thread
+//
+int threadPool::size( void ) const
+{
+  return workers.size()+1;
+}
+
+
+
+//
+// change the number of threads
+//
+void threadPool::resize( const int anthreads )
+{
+  stop();
+  start( anthreads );
+}
+
+
+
+//
+// create the workers
+//
+void threadPool::start( const int anthreads )
+{
+  int nthreads = anthreads;
+  if( nthreads <= 0 )
+    nthreads = thread::hardware_concurrency();
+  quit = false;
+  for( int n = 1; n < nthreads; n++ )
+    workers.push_back( thread( &threadPool::worker, this ) );
+}
+
+
+
+//
+// join the workers
+//
+void threadPool::stop( void )
+{
+  {
+    unique_lock<mutex> guard( lock );
+    quit = true;
+  }
+  wakeup.notify_all();
+  for( int n = 0; n < workers.size(); n++ )
+    workers[n].join();
+  workers.clear();
+}
+
+
+
+//
+// run a batch of tasks on the pool
+//
+void threadPool::runTasks( const int antasks, const void *atask, void (*acall)( const void*, const int ) )
+{
+  
+   // no workers or nothing to share
+   if( workers.empty() || (antasks <= 1) )
+   {
+      for( int k = 0; k < antasks; k++ )
+	acall( atask, k );
+      return;
+   }
+   
+   // publish the batch
+   {
+      unique_lock<mutex> guard( lock );
+      task   = atask;
+      call   = acall;
+      ntasks = antasks;
+      next   = 0;
+      busy   = workers.size();
+      batch++;
+   }
+   wakeup.notify_all();
+   
+   // take part in the batch
+   work();
+   
+   // wait for the workers to finish their last task
+   unique_lock<mutex> guard( lock );
+   while( 0 < busy )
+     finished.wait( guard );
+   task = 0;
+}
+
+
+
+//
+// take tasks of the current batch until there are none left
+//
+void threadPool::work( void )
+{
+   for( int k = next++; k < ntasks; k = next++ )
+     call( task, k );
+}
+
+
+
+//
+// the loop of a worker thread
+//
+void threadPool::worker( void )
+{
+   unsigned long seen = 0;
+   while( true )
+   {
+      
+      // wait for a new batch
+      {
+	unique_lock<mutex> guard( lock );
+	while( !quit && (seen == batch) )
+	  wakeup.wait( guard );
+	if( quit )
+	  return;
+	seen = batch;
+      }
+      
+      // run the tasks
+      work();
+      
+      // done with this batch
+      {
+	unique_lock<mutex> guard( lock );
+	busy--;
+	if( 0 == busy )
+	  finished.notify_one();
+      }
+   }
+}